@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "event.hpp"
+#include "occurrence.hpp"
+
+// Occurrences of many events merged into one stream ordered by date, time and
+// event id. Every event contributes a lazy Occurrences range and the heap only
+// holds the head of each, so nothing is materialized or sorted up front and
+// the caller can stop after the first few items.
+class Agenda {
+public:
+    struct Item {
+        const Event* event;
+        Occurrence occ;
+    };
+
+    Agenda(const std::vector<Event>& events, int from, int to) {
+        sources.reserve(events.size());
+        for (auto& e : events) {
+            auto range = std::make_unique<Occurrences>(e, from, to);
+            auto it = range->begin();
+            if (it == range->end()) continue;
+            sources.push_back(Source{&e, std::move(range), it});
+            heap.push_back(sources.size() - 1);
+        }
+        std::make_heap(heap.begin(), heap.end(), Later{this});
+    }
+    // false once every range is exhausted
+    bool next(Item& out) {
+        if (heap.empty()) return false;
+        std::pop_heap(heap.begin(), heap.end(), Later{this});
+        auto& s = sources[heap.back()];
+        out = Item{s.event, *s.it};
+        if (++s.it == s.range->end()) heap.pop_back();
+        else std::push_heap(heap.begin(), heap.end(), Later{this});
+        return true;
+    }
+
+private:
+    struct Source {
+        const Event* event;
+        std::unique_ptr<Occurrences> range;
+        Occurrences::iterator it;
+    };
+    std::vector<Source> sources;
+    std::vector<size_t> heap;  // indices into sources, earliest head on top
+
+    // heap order: the source whose head comes later sinks
+    struct Later {
+        const Agenda* self;
+        bool operator()(size_t a, size_t b) const {
+            auto& x = self->sources[a];
+            auto& y = self->sources[b];
+            if (x.it->date != y.it->date) return x.it->date > y.it->date;
+            if (x.it->slot.start != y.it->slot.start) return x.it->slot.start > y.it->slot.start;
+            return x.event->id > y.event->id;
+        }
+    };
+};
@@ -0,0 +1,72 @@
+// Compares the civil-calendar arithmetic of calendar.hpp with the mktime
+// based get_weekday()/add_days() it replaced.
+//
+//   g++ -std=c++17 -O2 bench/bench_civil.cpp -o bench_civil
+//   ./bench_civil [iterations]      (default: 1000000)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "../calendar.hpp"
+
+std::tm to_tm(Date d) {
+    std::tm res{};
+    res.tm_year = d.year - 1900;
+    res.tm_mon = d.month - 1;
+    res.tm_mday = d.day;
+    res.tm_isdst = -1;
+    return res;
+}
+int mktime_weekday(Date d) {
+    std::tm t = to_tm(d);
+    std::mktime(&t);
+    return t.tm_wday;
+}
+Date mktime_add_days(Date d, int days) {
+    std::tm t = to_tm(d);
+    t.tm_mday += days;
+    std::mktime(&t);
+    return Date{t.tm_year + 1900, t.tm_mon + 1, t.tm_mday};
+}
+
+template <class F>
+double measure(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    // both must agree on every day they are compared on
+    Date d{1971, 1, 1};
+    for (int i = 0; i < 366 * 100; ++i, d = add_days(d, 1)) {
+        Date m = mktime_add_days(d, 1);
+        if (!(m == add_days(d, 1)) || mktime_weekday(d) != get_weekday(d)) {
+            printf("mismatch at %s\n", d.dump().c_str());
+            return 1;
+        }
+    }
+
+    long long sink = 0;
+    printf("%-24s %12s %12s\n", "operation", "mktime ms", "civil ms");
+    double a = measure([&] {
+        Date d{2000, 1, 1};
+        for (int i = 0; i < n; ++i, d = mktime_add_days(d, 1)) sink += d.day;
+    });
+    double b = measure([&] {
+        Date d{2000, 1, 1};
+        for (int i = 0; i < n; ++i, d = add_days(d, 1)) sink += d.day;
+    });
+    printf("%-24s %12.1f %12.1f\n", "add_days(d, 1)", a, b);
+    a = measure([&] {
+        Date d{2000, 1, 1};
+        for (int i = 0; i < n; ++i, d.day = d.day % 28 + 1) sink += mktime_weekday(d);
+    });
+    b = measure([&] {
+        Date d{2000, 1, 1};
+        for (int i = 0; i < n; ++i, d.day = d.day % 28 + 1) sink += get_weekday(d);
+    });
+    printf("%-24s %12.1f %12.1f\n", "get_weekday(d)", a, b);
+    return sink == 42;
+}
@@ -0,0 +1,111 @@
+// Compares the ways of loading data.json on synthetic calendars.
+//
+//   g++ -std=c++17 -O2 bench/bench_load.cpp -o bench_load
+//   ./bench_load [event counts...]      (default: 10000 100000 1000000)
+//
+// legacy: the original read_events(): read char by char, DOM, copy, sort
+// dom:    whole-file string, DOM, decode_event() per event
+// sax:    load_json_snapshot(), the single SAX pass used by read_events()
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include "../storage.hpp"
+
+Event make_event(int id) {
+    json j;
+    static const char* types[] = {"schedule", "point", "deadline"};
+    static const char* repetitions[] = {"Once", "Daily", "Weekly", "Monthly", "Yearly", "Custom"};
+    j["id"] = id;
+    j["type"] = types[id % 3];
+    j["priority"] = id % 2 ? "High" : "Low";
+    j["title"] = "Event " + to_string(id);
+    j["description"] = "generated by bench_load";
+    j["category"] = "bench";
+    j["repetition"] = repetitions[id % 6];
+    j["start_time"] = "09:30";
+    j["duration"] = "1:15";
+    j["time"] = "18:00";
+    j["date"] = "2025-04-15";
+    j["start_date"] = "2025-01-01";
+    j["end_date"] = id % 4 ? "-1" : "2026-12-31";
+    j["banned"] = json::array({{{"l", "2025-03-01"}, {"r", "2025-03-10"}}});
+    j["completed"] = id % 6 ? json::array() : json(false);
+    if (id % 6 == 2) j["enabled_days"] = {1, 3, 5};
+    if (id % 6 == 3) j["enabled_days"] = {1, 15, 31};
+    if (id % 6 == 4) j["enabled_days"] = {"03-14", "12-25"};
+    j["same_time_each_day"] = true;
+    j["subevents"] = json::array({{{"date", "2025-05-01"}, {"completed", false}}, {{"date", "2025-05-03"}, {"completed", false}}});
+    return decode_event(j);
+}
+
+// same layout as compact() writes, without holding the DOM of the whole file
+void write_calendar(int n) {
+    std::ofstream file(DATA_FILE, std::ios::binary);
+    file << "{\n    \"events\": [";
+    for (int id = 1; id <= n; ++id) {
+        std::string s = encode_event(make_event(id)).dump(4);
+        std::string indented;
+        for (char c : s) {
+            indented += c;
+            if (c == '\n') indented += "        ";
+        }
+        file << (id == 1 ? "\n        " : ",\n        ") << indented;
+    }
+    file << "\n    ],\n    \"total\": " << n << "\n}";
+}
+
+void load_legacy() {
+    std::ifstream file(DATA_FILE);
+    std::string tmp;
+    while (true) {
+        char c = file.get();
+        if (file.eof()) break;
+        tmp += c;
+    }
+    json data = json::parse(tmp);
+    tot = data["total"];
+    std::vector<json> res = data["events"];
+    std::sort(res.begin(), res.end(), [](const json& a, const json& b) {
+        return a["id"] < b["id"];
+    });
+    if (res.size() != (size_t)tot) std::abort();
+}
+void load_dom() {
+    json data = json::parse(read_from_file(DATA_FILE));
+    tot = data["total"];
+    events.clear();
+    for (auto& e : data["events"]) events.push_back(decode_event(e));
+    if (events.size() != (size_t)tot) std::abort();
+}
+void load_sax() {
+    load_json_snapshot();
+    if (events.size() != (size_t)tot) std::abort();
+}
+
+double measure(void (*f)()) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::atoi(argv[i]));
+    if (sizes.empty()) sizes = {10000, 100000, 1000000};
+    auto dir = std::filesystem::temp_directory_path() / "planalyze_bench_load";
+    std::filesystem::create_directories(dir);
+    std::filesystem::current_path(dir);
+    printf("%10s %10s %12s %12s %12s\n", "events", "MiB", "legacy ms", "dom ms", "sax ms");
+    for (int n : sizes) {
+        write_calendar(n);
+        double mib = std::filesystem::file_size(DATA_FILE) / 1048576.0;
+        double legacy = measure(load_legacy);
+        double dom = measure(load_dom);
+        double sax = measure(load_sax);
+        printf("%10d %10.1f %12.1f %12.1f %12.1f\n", n, mib, legacy, dom, sax);
+    }
+    std::filesystem::current_path(dir.parent_path());
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,124 @@
+// Compares the string_view parsers of calendar.hpp with the split() based
+// ones they replaced, on a batch of dates, times and durations like the ones
+// found in data.json. Heap allocations are counted through operator new.
+// Before timing anything it checks that both agree on every sample and that
+// every duration Duration::dump() writes, "0:mm" included, parses back.
+//
+//   g++ -std=c++17 -O2 bench/bench_parse.cpp -o bench_parse
+//   ./bench_parse [iterations]      (default: 1000000)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "../calendar.hpp"
+
+static long long allocations;
+void* operator new(std::size_t n) {
+    ++allocations;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// the previous implementation: copies the input and builds a vector of strings
+std::vector<std::string> legacy_split(std::string s, char c) {
+    std::vector<std::string> res{""};
+    for (auto& x : s) {
+        if (x == c) res.push_back("");
+        else res.back() += x;
+    }
+    return res;
+}
+int legacy_to_uint(std::string s) {
+    int res = 0;
+    for (char c : s) {
+        if (!isdigit(c)) return -1;
+        res = res * 10 + c - '0';
+    }
+    return res;
+}
+Date legacy_date(std::string s) {
+    auto x = legacy_split(s, '-');
+    if (x.size() != 3) return Date{-1, -1, -1};
+    int year = legacy_to_uint(x[0]);
+    int month = legacy_to_uint(x[1]);
+    int day = legacy_to_uint(x[2]);
+    if (year < 1900 || month < 1 || day < 1) return Date{-1, -1, -1};
+    if (month > 12 || day > get_month_day(year, month)) return Date{-1, -1, -1};
+    return Date{year, month, day};
+}
+Time legacy_time(std::string s) {
+    auto x = legacy_split(s, ':');
+    if (x.size() != 2) return Time{-1, -1};
+    int hour = legacy_to_uint(x[0]);
+    int minute = legacy_to_uint(x[1]);
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59) return Time{-1, -1};
+    return Time{hour, minute};
+}
+Duration legacy_duration(std::string s) {
+    auto x = legacy_split(s, ':');
+    if (x.size() == 1) return Duration{legacy_to_uint(x[0])};
+    if (x.size() == 2) {
+        int hour = legacy_to_uint(x[0]);
+        int minute = legacy_to_uint(x[1]);
+        if (hour < 0 || minute < 0 || minute > 59) return Duration{-1};
+        return Duration{hour * 60 + minute};
+    }
+    return Duration{-1};
+}
+
+template <class F>
+double measure(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::vector<std::string> dates = {"2025-01-06", "2024-02-29", "2023-02-29", "1899-12-31", "2025-1-6", "-1", "2025-13-01", ""};
+    const std::vector<std::string> times = {"09:30", "23:59", "24:00", ":5", "7:", "-1", "12:60", "1:2:3"};
+    const std::vector<std::string> durations = {"1:15", "90", "0:30", ":30", "1:60", "-1", "", "1:2:3"};
+
+    // both must give the same answer for every sample
+    for (auto& s : dates) {
+        if (!(legacy_date(s) == Date::parse(s))) return printf("date mismatch on \"%s\"\n", s.c_str()), 1;
+    }
+    for (auto& s : times) {
+        if (legacy_time(s).pack() != Time::parse(s).pack()) return printf("time mismatch on \"%s\"\n", s.c_str()), 1;
+    }
+    for (auto& s : durations) {
+        if (legacy_duration(s).minute != Duration::parse(s).minute) return printf("duration mismatch on \"%s\"\n", s.c_str()), 1;
+    }
+    // what encode_event() writes for reminder leads and durations
+    for (int minute = 0; minute <= 48 * 60; ++minute) {
+        std::string s = Duration{minute}.dump();
+        if (Duration::parse(s).minute != minute) return printf("duration %d written as \"%s\" does not parse back\n", minute, s.c_str()), 1;
+        if (s != std::to_string(minute / 60) + ":" + (minute % 60 < 10 ? "0" : "") + std::to_string(minute % 60)) {
+            return printf("duration %d written as \"%s\", not h:mm\n", minute, s.c_str()), 1;
+        }
+    }
+
+    long long sink = 0;
+    printf("%-12s %12s %12s %14s %14s\n", "parser", "split ms", "view ms", "split allocs", "view allocs");
+    auto run = [&](const char* name, auto legacy, auto current) {
+        long long before = allocations;
+        double a = measure([&] {
+            for (int i = 0; i < n; ++i) sink += legacy(i);
+        });
+        long long legacy_allocs = allocations - before;
+        before = allocations;
+        double b = measure([&] {
+            for (int i = 0; i < n; ++i) sink += current(i);
+        });
+        printf("%-12s %12.1f %12.1f %14lld %14lld\n", name, a, b, legacy_allocs, allocations - before);
+    };
+    run("Date", [&](int i) { return legacy_date(dates[i % 8]).day; },
+        [&](int i) { return Date::parse(dates[i % 8]).day; });
+    run("Time", [&](int i) { return legacy_time(times[i % 8]).minute; },
+        [&](int i) { return Time::parse(times[i % 8]).minute; });
+    run("Duration", [&](int i) { return legacy_duration(durations[i % 8]).minute; },
+        [&](int i) { return Duration::parse(durations[i % 8]).minute; });
+    return sink == 42;
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr bool is_leap_year(int year) {
+    if (year % 400 == 0) return 1;
+    if (year % 100 == 0) return 0;
+    if (year % 4 == 0) return 1;
+    return 0;
+}
+constexpr int get_month_day(int year, int month) {
+    if (month == 2) return is_leap_year(year) + 28;
+    if (month < 8) return 30 + month % 2;
+    return 31 - month % 2;
+}
+
+// Civil (proleptic Gregorian) calendar arithmetic on days since 1970-01-01,
+// after Howard Hinnant's days_from_civil/civil_from_days. Pure integer code,
+// so stepping through dates never goes through mktime and its timezone/DST
+// handling.
+constexpr int days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yoe = year - era * 400;                                            // [0, 399]
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;  // [0, 365]
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                       // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
+struct CivilDate {
+    int year, month, day;
+};
+constexpr CivilDate civil_from_days(int z) {
+    z += 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    const int day = doy - (153 * mp + 2) / 5 + 1;
+    const int month = mp < 10 ? mp + 3 : mp - 9;
+    return CivilDate{yoe + era * 400 + (month <= 2), month, day};
+}
+// 0 = Sunday, like tm_wday; 1970-01-01 was a Thursday
+constexpr int weekday_from_days(int z) {
+    return z >= -4 ? (z + 4) % 7 : (z + 5) % 7 + 6;
+}
+static_assert(days_from_civil(1970, 1, 1) == 0);
+static_assert(days_from_civil(2000, 3, 1) == 11017);
+static_assert(civil_from_days(11016).month == 2 && civil_from_days(11016).day == 29);
+static_assert(weekday_from_days(days_from_civil(2025, 1, 6)) == 1);
+
+// packed form of a missing date or an open range bound ("-1" in data.json);
+// it orders before every real date
+const int NO_DATE = INT_MIN;
+
+std::string to_string(int x, int n = -1) {
+    std::string res;
+    for (int i = 0; n == -1 ? x : (i < n); ++i) res += char(x % 10 + '0'), x /= 10;
+    std::reverse(res.begin(), res.end());
+    return res;
+}
+// digits only, "" is 0; -1 for anything else, including overflow
+int to_uint(std::string_view s) {
+    int res = 0;
+    if (s.empty()) return 0;
+    if (!isdigit((unsigned char)s[0])) return -1;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), res);
+    if (ec != std::errc() || end != s.data() + s.size()) return -1;
+    return res;
+}
+// writes x as exactly n digits, zero padded
+char* _put_digits(char* p, int x, int n) {
+    for (int i = n - 1; i >= 0; --i) p[i] = char(x % 10 + '0'), x /= 10;
+    return p + n;
+}
+std::vector<std::string> split(std::string_view s, char c) {
+    std::vector<std::string> res;
+    for (size_t pos = 0;; ++pos) {
+        size_t next = s.find(c, pos);
+        res.emplace_back(s.substr(pos, next - pos));
+        if (next == std::string_view::npos) return res;
+        pos = next;
+    }
+}
+// allocation-free split for the parsers below: stores up to n pieces of s in
+// out and returns how many pieces there are in total
+size_t _split_fields(std::string_view s, char c, std::string_view* out, size_t n) {
+    size_t count = 0;
+    for (size_t pos = 0;; ++pos) {
+        size_t next = s.find(c, pos);
+        if (count < n) out[count] = s.substr(pos, next - pos);
+        ++count;
+        if (next == std::string_view::npos) return count;
+        pos = next;
+    }
+}
+
+struct Date {
+    int year, month, day;
+    // json values only convert to std::string; const char* would be ambiguous
+    // between the two
+    static Date parse(const std::string& s) {
+        return parse(std::string_view(s));
+    }
+    static Date parse(const char* s) {
+        return parse(std::string_view(s));
+    }
+    static Date parse(std::string_view s) {
+        std::string_view x[3];
+        if (_split_fields(s, '-', x, 3) != 3) return Date{-1, -1, -1};
+        int year = to_uint(x[0]);
+        int month = to_uint(x[1]);
+        int day = to_uint(x[2]);
+        if (year < 1900 || month < 1 || day < 1) return Date{-1, -1, -1};
+        if (month > 12 || day > get_month_day(year, month)) return Date{-1, -1, -1};
+        return Date{year, month, day};
+    }
+    static Date from_days(int z) {
+        auto c = civil_from_days(z);
+        return Date{c.year, c.month, c.day};
+    }
+    int to_days() const {
+        return days_from_civil(year, month, day);
+    }
+    // canonical packed form: days since 1970-01-01, NO_DATE for Date{-1, -1, -1}
+    static Date unpack(int x) {
+        if (x == NO_DATE) return Date{-1, -1, -1};
+        return from_days(x);
+    }
+    int pack() const {
+        if (year < 0) return NO_DATE;
+        return to_days();
+    }
+    std::string dump() {
+        if (year < 0) return "-1";
+        char buf[10];
+        _put_digits(_put_digits(_put_digits(buf, year, 4) + 1, month, 2) + 1, day, 2);
+        buf[4] = buf[7] = '-';
+        return std::string(buf, 10);
+    }
+    bool operator<(const Date& other) const {
+        if (year != other.year) return year < other.year;
+        if (month != other.month) return month < other.month;
+        return day < other.day;
+    }
+    bool operator==(const Date& other) const {
+        return year == other.year && month == other.month && day == other.day;
+    }
+};
+struct DateWithoutYear {
+    int month, day;
+    static DateWithoutYear parse(const std::string& s) {
+        return parse(std::string_view(s));
+    }
+    static DateWithoutYear parse(const char* s) {
+        return parse(std::string_view(s));
+    }
+    static DateWithoutYear parse(std::string_view s) {
+        std::string_view x[2];
+        if (_split_fields(s, '-', x, 2) != 2) return DateWithoutYear{-1, -1};
+        int month = to_uint(x[0]);
+        int day = to_uint(x[1]);
+        if (month < 1 || day < 1) return DateWithoutYear{-1, -1};
+        if (month > 12 || day > get_month_day(2000, month)) return DateWithoutYear{-1, -1};
+        return DateWithoutYear{month, day};
+    }
+    // packed form mmdd
+    static DateWithoutYear unpack(int x) {
+        if (x < 0) return DateWithoutYear{-1, -1};
+        return DateWithoutYear{x / 100, x % 100};
+    }
+    int pack() const {
+        if (month < 0) return -1;
+        return month * 100 + day;
+    }
+    std::string dump() {
+        if (month < 0) return "-1";
+        char buf[5];
+        _put_digits(_put_digits(buf, month, 2) + 1, day, 2);
+        buf[2] = '-';
+        return std::string(buf, 5);
+    }
+    bool operator<(const DateWithoutYear& other) const {
+        if (month != other.month) return month < other.month;
+        return day < other.day;
+    }
+    bool operator==(const DateWithoutYear& other) const {
+        return month == other.month && day == other.day;
+    }
+};
+// day of a leap year, 0 for 01-01 and 59 for 02-29, so every mm-dd has a slot
+constexpr int _days_before_month[13] = {0, 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335};
+constexpr int year_slot(int month, int day) {
+    return _days_before_month[month] + day - 1;
+}
+DateWithoutYear from_year_slot(int slot) {
+    int month = int(std::upper_bound(_days_before_month + 1, _days_before_month + 13, slot) - _days_before_month) - 1;
+    return DateWithoutYear{month, slot - _days_before_month[month] + 1};
+}
+struct Time {
+    int hour, minute;
+    static Time parse(const std::string& s) {
+        return parse(std::string_view(s));
+    }
+    static Time parse(const char* s) {
+        return parse(std::string_view(s));
+    }
+    static Time parse(std::string_view s) {
+        std::string_view x[2];
+        if (_split_fields(s, ':', x, 2) != 2) return Time{-1, -1};
+        int hour = to_uint(x[0]);
+        int minute = to_uint(x[1]);
+        if (hour < 0 || hour > 23 || minute < 0 || minute > 59) return Time{-1, -1};
+        return Time{hour, minute};
+    }
+    // packed form: minutes of the day, -1 for no time
+    static Time unpack(int x) {
+        if (x < 0) return Time{-1, -1};
+        return Time{x / 60, x % 60};
+    }
+    int pack() const {
+        if (minute < 0) return -1;
+        return hour * 60 + minute;
+    }
+    std::string dump() {
+        if (minute < 0) return "-1";
+        char buf[5];
+        _put_digits(_put_digits(buf, hour, 2) + 1, minute, 2);
+        buf[2] = ':';
+        return std::string(buf, 5);
+    }
+    bool operator<(const Time& other) const {
+        if (other.hour != hour) return hour < other.hour;
+        return minute < other.minute;
+    }
+};
+struct Duration {
+    int minute;
+    static Duration parse(const std::string& s) {
+        return parse(std::string_view(s));
+    }
+    static Duration parse(const char* s) {
+        return parse(std::string_view(s));
+    }
+    static Duration parse(std::string_view s) {
+        std::string_view x[2];
+        size_t n = _split_fields(s, ':', x, 2);
+        if (n == 1) {
+            return Duration{to_uint(x[0])};
+        }
+        if (n == 2) {
+            int hour = to_uint(x[0]);
+            int minute = to_uint(x[1]);
+            if (hour < 0 || minute < 0 || minute > 59) return Duration{-1};
+            return Duration{hour * 60 + minute};
+        }
+        return Duration{-1};
+    }
+    std::string dump() {
+        return (minute < 60 ? "0" : to_string(minute / 60)) + ":" + to_string(minute % 60, 2);
+    }
+};
+
+std::pair<Date, Time> split_date_time(std::tm t) {
+    return {Date{t.tm_year + 1900, t.tm_mon + 1, t.tm_mday}, Time{t.tm_hour, t.tm_min}};
+}
+
+int get_weekday(Date d) {
+    return weekday_from_days(d.to_days());
+}
+Date add_days(Date d, int days) {
+    return Date::from_days(d.to_days() + days);
+}
+
+Time operator+(Time a, const Duration& b) {
+    a.minute += b.minute;
+    a.hour += a.minute / 60;
+    a.minute %= 60;
+    a.hour %= 24;
+    return a;
+}
+Time operator-(Time a,const Duration& b){
+    int digit=0;
+    a.minute -= b.minute;
+    while(a.minute<0){
+        a.minute+=60;
+        digit+=1;
+    }
+    a.hour -=digit;
+    while(a.minute<0){
+        a.hour+=24;
+    }
+    return a;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "socket.hpp"
+
+using json = nlohmann::json;
+
+// Optional resident planalyze (planalyze --daemon). It keeps the calendar in
+// memory and answers the commands of other planalyze invocations started in
+// the same directory, which forward their arguments over the Unix domain
+// socket DAEMON_SOCKET instead of loading the data files themselves. A request
+// is one json line {"argv": [...]}; the answer is the command's output, after
+// which the daemon closes the connection. Without a daemon listening, connect
+// fails at once and the command runs in-process as before.
+const std::string DAEMON_SOCKET = "planalyze.sock";
+const int DAEMON_TIMEOUT_MS = 5000;  // a client that never sends its request or never reads the answer
+
+// false if path does not fit a sockaddr_un
+bool _daemon_address(const std::string& path, sockaddr_un& addr) {
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+// a connection to the daemon, NO_SOCKET in it if none is running
+socket_t _daemon_connect() {
+    sockaddr_un addr;
+    if (!std::filesystem::exists(DAEMON_SOCKET) || !_daemon_address(DAEMON_SOCKET, addr)) return NO_SOCKET;
+    _socket_startup();
+    socket_t s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == NO_SOCKET) return NO_SOCKET;
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close_socket(s);
+        return NO_SOCKET;
+    }
+    return s;
+}
+
+// runs the command in the daemon and writes its output to out; false if no
+// daemon answered, in which case nothing was written
+bool daemon_forward(const std::vector<std::string>& args, std::ostream& out) {
+    Connection c(_daemon_connect());
+    if (c.s == NO_SOCKET) return false;
+    try {
+        c.send_all(json{{"argv", args}}.dump() + "\n");
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    for (std::string chunk; !(chunk = c.receive_some()).empty();) out << chunk;
+    out.flush();
+    return true;
+}
+
+// serves requests one at a time until the process is stopped; run executes
+// one command and returns what it printed. false if the socket cannot be had.
+bool run_daemon(std::function<std::string(const std::vector<std::string>&)> run) {
+    {
+        Connection other(_daemon_connect());
+        if (other.s != NO_SOCKET) {
+            std::cout << "A daemon is already running in this directory.\n";
+            return false;
+        }
+    }
+    sockaddr_un addr;
+    if (!_daemon_address(DAEMON_SOCKET, addr)) return false;
+    _socket_startup();
+    std::error_code ec;
+    std::filesystem::remove(DAEMON_SOCKET, ec);  // left behind by a daemon that was killed
+    Connection listener(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.s == NO_SOCKET || bind(listener.s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener.s, SOMAXCONN) != 0) {
+        std::cout << "Cannot listen on " << DAEMON_SOCKET << ".\n";
+        return false;
+    }
+    std::cout << "Serving commands on " << DAEMON_SOCKET << "." << std::endl;
+    while (true) {
+        Connection c(accept(listener.s, NULL, NULL));
+        if (c.s == NO_SOCKET) continue;
+        set_timeouts(c.s, DAEMON_TIMEOUT_MS);
+        std::string request;
+        while (request.find('\n') == std::string::npos) {
+            std::string chunk = c.receive_some();
+            if (chunk.empty()) break;
+            request += chunk;
+        }
+        json j = json::parse(request, nullptr, false);
+        if (j.is_discarded() || !j.contains("argv") || !j["argv"].is_array()) continue;
+        std::vector<std::string> args;
+        for (auto& x : j["argv"]) {
+            if (x.is_string()) args.push_back(x.get<std::string>());
+        }
+        try {
+            c.send_all(run(args));
+        } catch (const std::runtime_error&) {
+            // the client went away or stopped reading
+        }
+    }
+}
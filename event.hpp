@@ -0,0 +1,527 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+#include "calendar.hpp"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Typed in-memory form of one entry of data.json. Events are decoded once when
+// the calendar is loaded and encoded once when it is saved; everything in
+// between works on packed integers (Date::pack() days, Time::pack() minutes)
+// instead of string-keyed json lookups and "yyyy-mm-dd" comparisons.
+
+enum class EventType : uint8_t { Schedule, Point, Deadline };
+enum class Priority : uint8_t { Low, Medium, High };
+// order matches the alternatives of Rule
+enum class Repetition : uint8_t { Once, Daily, Weekly, Monthly, Yearly, Custom };
+
+const char* dump(EventType x) {
+    static const char* names[] = {"schedule", "point", "deadline"};
+    return names[int(x)];
+}
+const char* dump(Priority x) {
+    static const char* names[] = {"Low", "Medium", "High"};
+    return names[int(x)];
+}
+const char* dump(Repetition x) {
+    static const char* names[] = {"Once", "Daily", "Weekly", "Monthly", "Yearly", "Custom"};
+    return names[int(x)];
+}
+EventType parse_event_type(const std::string& s) {
+    if (s == "point") return EventType::Point;
+    if (s == "deadline") return EventType::Deadline;
+    return EventType::Schedule;
+}
+Priority parse_priority(const std::string& s) {
+    if (s == "Medium") return Priority::Medium;
+    if (s == "High") return Priority::High;
+    return Priority::Low;
+}
+
+// start is `start_time` for schedules and `time` otherwise, in minutes of the
+// day (-1 if unset); duration only matters for schedules
+struct Slot {
+    int start = -1;
+    int duration = 0;
+    int end() const { return (Time::unpack(start) + Duration{duration}).pack(); }
+};
+
+// inclusive range of packed dates, NO_DATE on either side for an open bound
+struct BanInterval {
+    int l, r;
+    bool operator==(const BanInterval& other) const { return l == other.l && r == other.r; }
+};
+
+// Banned ranges of a rule as a sorted set of disjoint intervals. Inserting
+// coalesces the new range with every range it overlaps or touches, so an
+// event keeps one entry per run of cancelled days and a lookup is one binary
+// search. An open left bound (NO_DATE) already sorts first; an open right
+// bound is compared as +infinity but kept as NO_DATE, like in data.json.
+class BanSet {
+public:
+    using const_iterator = std::map<int, int>::const_iterator;  // l -> r
+
+    // adds x; a following range is merged in if it starts no later than
+    // next(r), the first day after r that is not covered anyway (r + 1 unless
+    // the caller knows that the days in between never occur). Amortized
+    // O(log n): every range merged away was inserted once.
+    template <class Next>
+    void insert(BanInterval x, Next next) {
+        int l = x.l, r = _right(x.r);
+        if (l != NO_DATE && r < l) return;
+        auto it = ranges.upper_bound(l);
+        if (it != ranges.begin()) {
+            auto p = std::prev(it);
+            int pr = _right(p->second);
+            if (pr == INT_MAX || next(pr) >= l) {
+                l = p->first;
+                r = std::max(r, pr);
+                ranges.erase(p);
+            }
+        }
+        while (it != ranges.end() && (r == INT_MAX || it->first <= next(r))) {
+            r = std::max(r, _right(it->second));
+            it = ranges.erase(it);
+        }
+        ranges.emplace_hint(it, l, r == INT_MAX ? NO_DATE : r);
+    }
+    void insert(BanInterval x) {
+        insert(x, [](int r) { return r + 1; });
+    }
+    bool contains(int day) const {
+        auto it = ranges.upper_bound(day);
+        return it != ranges.begin() && _right(std::prev(it)->second) >= day;
+    }
+    // first day >= day outside every range, INT_MAX if there is none
+    int next_allowed(int day) const {
+        auto it = ranges.upper_bound(day);
+        if (it == ranges.begin()) return day;
+        int r = _right(std::prev(it)->second);
+        if (r < day) return day;
+        return r == INT_MAX ? INT_MAX : r + 1;  // ranges never touch, so r + 1 is free
+    }
+    size_t size() const { return ranges.size(); }
+    bool empty() const { return ranges.empty(); }
+    const_iterator begin() const { return ranges.begin(); }
+    const_iterator end() const { return ranges.end(); }
+
+private:
+    std::map<int, int> ranges;
+    static int _right(int r) { return r == NO_DATE ? INT_MAX : r; }
+};
+
+// set of days out of N as a bitmask, so membership is a bit test and finding
+// the next enabled day is a count-trailing-zeros
+template <int N>
+struct DayMask {
+    static const int WORDS = (N + 63) / 64;
+    uint64_t words[WORDS] = {};
+
+    void set(int i) {
+        if (i >= 0 && i < N) words[i >> 6] |= 1ull << (i & 63);
+    }
+    bool test(int i) const {
+        return i >= 0 && i < N && (words[i >> 6] >> (i & 63) & 1);
+    }
+    int count() const {
+        int res = 0;
+        for (auto w : words) res += __builtin_popcountll(w);
+        return res;
+    }
+    // first day >= i in the set, -1 if there is none
+    int next(int i) const {
+        i = std::max(i, 0);
+        for (int k = i >> 6; k < WORDS; ++k) {
+            uint64_t w = k == i >> 6 ? words[k] & (~0ull << (i & 63)) : words[k];
+            if (w) return k * 64 + __builtin_ctzll(w);
+        }
+        return -1;
+    }
+    std::vector<int> list() const {
+        std::vector<int> res;
+        for (int i = next(0); i >= 0; i = next(i + 1)) res.push_back(i);
+        return res;
+    }
+};
+
+// common part of the Daily/Weekly/Monthly/Yearly rules
+struct Span {
+    int start_date = NO_DATE, end_date = NO_DATE;
+    BanSet banned;
+    json completed = json::array();  // kept verbatim, not interpreted here
+};
+
+struct OnceRule {
+    int date = NO_DATE;
+    bool completed = false;
+};
+struct DailyRule {
+    Span span;
+};
+struct WeeklyRule {
+    Span span;
+    DayMask<7> enabled_days;  // weekdays, 0 = Sunday
+};
+struct MonthlyRule {
+    Span span;
+    DayMask<32> enabled_days;  // days of month, bit 0 unused
+};
+struct YearlyRule {
+    Span span;
+    DayMask<366> enabled_days;  // year_slot() of each mm-dd
+};
+struct Subevent {
+    int date = NO_DATE;
+    bool completed = false;
+    Slot slot;  // only used when same_time_each_day is false
+};
+struct CustomRule {
+    bool same_time_each_day = true;
+    std::vector<Subevent> subevents;
+};
+
+using Rule = std::variant<OnceRule, DailyRule, WeeklyRule, MonthlyRule, YearlyRule, CustomRule>;
+
+struct Event {
+    int id = 0;
+    EventType type = EventType::Schedule;
+    Priority priority = Priority::Low;
+    std::string title, description, category;
+    Slot slot;
+    Rule rule;
+    std::vector<int> leads;  // reminder lead times in minutes, ascending; empty reminds at the start only
+
+    Repetition repetition() const { return Repetition(rule.index()); }
+    bool is_schedule() const { return type == EventType::Schedule; }
+    // null for Once and Custom
+    Span* span() {
+        switch (repetition()) {
+        case Repetition::Daily: return &std::get<DailyRule>(rule).span;
+        case Repetition::Weekly: return &std::get<WeeklyRule>(rule).span;
+        case Repetition::Monthly: return &std::get<MonthlyRule>(rule).span;
+        case Repetition::Yearly: return &std::get<YearlyRule>(rule).span;
+        default: return nullptr;
+        }
+    }
+    const Span* span() const { return const_cast<Event*>(this)->span(); }
+    bool has_enabled_days() const {
+        return repetition() >= Repetition::Weekly && repetition() <= Repetition::Yearly;
+    }
+    // enabled days as data.json lists them: weekdays, days of month or packed
+    // DateWithoutYear, ascending; empty for the other rules
+    std::vector<int> enabled_day_list() const {
+        if (auto x = std::get_if<WeeklyRule>(&rule)) return x->enabled_days.list();
+        if (auto x = std::get_if<MonthlyRule>(&rule)) return x->enabled_days.list();
+        std::vector<int> res;
+        if (auto x = std::get_if<YearlyRule>(&rule)) {
+            for (int slot : x->enabled_days.list()) res.push_back(from_year_slot(slot).pack());
+        }
+        return res;
+    }
+};
+
+// raw values of one data.json entry before they are given their types; filled
+// either from a json object (decode_event) or straight from the SAX stream
+// (event_sax.hpp)
+struct SubeventFields {
+    std::string date, start_time, duration, time;
+    bool completed = false;
+};
+struct EventFields {
+    int id = 0;
+    std::string type, priority, title, description, category, repetition;
+    std::string start_time, duration, time, date, start_date, end_date;
+    bool completed = false;                // Once
+    json completed_list = json::array();   // Daily/Weekly/Monthly/Yearly
+    bool same_time_each_day = true;
+    std::vector<std::pair<std::string, std::string>> banned;
+    std::vector<int> enabled_days;         // Weekly/Monthly
+    std::vector<std::string> yearly_days;  // Yearly
+    std::vector<SubeventFields> subevents;
+    std::vector<std::string> reminders;    // lead times (hh:mm)
+};
+
+Slot _make_slot(const std::string& start_time, const std::string& duration, const std::string& time, bool schedule) {
+    Slot res;
+    if (schedule) {
+        res.start = Time::parse(start_time).pack();
+        res.duration = std::max(Duration::parse(duration).minute, 0);
+    } else {
+        res.start = Time::parse(time).pack();
+    }
+    return res;
+}
+void _put_slot(json& j, const Slot& s, bool schedule) {
+    if (s.start < 0) return;
+    if (schedule) {
+        j["start_time"] = Time::unpack(s.start).dump();
+        j["duration"] = Duration{s.duration}.dump();
+        j["end_time"] = Time::unpack(s.end()).dump();
+    } else {
+        j["time"] = Time::unpack(s.start).dump();
+    }
+}
+Span _make_span(EventFields& f) {
+    Span res;
+    res.start_date = Date::parse(f.start_date).pack();
+    res.end_date = Date::parse(f.end_date).pack();
+    for (auto& [l, r] : f.banned) {
+        res.banned.insert(BanInterval{Date::parse(l).pack(), Date::parse(r).pack()});
+    }
+    res.completed = std::move(f.completed_list);
+    return res;
+}
+void _put_span(json& j, const Span& s) {
+    j["start_date"] = Date::unpack(s.start_date).dump();
+    j["end_date"] = Date::unpack(s.end_date).dump();
+    j["banned"] = json::array();
+    for (auto& [l, r] : s.banned) {
+        j["banned"].push_back(json{{"l", Date::unpack(l).dump()}, {"r", Date::unpack(r).dump()}});
+    }
+    j["completed"] = s.completed;
+}
+// Weekly/Monthly/Yearly rule from enabled days given the way
+// Event::enabled_day_list() returns them; days that cannot occur are dropped
+Rule _make_day_rule(Repetition repetition, Span span, const std::vector<int>& days) {
+    if (repetition == Repetition::Weekly) {
+        WeeklyRule res;
+        res.span = std::move(span);
+        for (int d : days) res.enabled_days.set(d);
+        return res;
+    }
+    if (repetition == Repetition::Monthly) {
+        MonthlyRule res;
+        res.span = std::move(span);
+        for (int d : days) {
+            if (d >= 1) res.enabled_days.set(d);
+        }
+        return res;
+    }
+    YearlyRule res;
+    res.span = std::move(span);
+    for (int d : days) {
+        auto md = DateWithoutYear::unpack(d);
+        if (md.month >= 1 && md.month <= 12 && md.day >= 1 && md.day <= get_month_day(2000, md.month)) {
+            res.enabled_days.set(year_slot(md.month, md.day));
+        }
+    }
+    return res;
+}
+Rule _make_days(EventFields& f, Repetition repetition) {
+    if (repetition != Repetition::Yearly) return _make_day_rule(repetition, _make_span(f), f.enabled_days);
+    std::vector<int> days;
+    for (auto& x : f.yearly_days) days.push_back(DateWithoutYear::parse(x).pack());
+    return _make_day_rule(repetition, _make_span(f), days);
+}
+
+std::vector<int> _make_leads(const std::vector<std::string>& reminders) {
+    std::vector<int> res;
+    for (auto& s : reminders) {
+        int x = Duration::parse(s).minute;
+        if (x >= 0) res.push_back(x);
+    }
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+}
+
+Event build_event(EventFields& f) {
+    Event e;
+    e.id = f.id;
+    e.type = parse_event_type(f.type);
+    e.priority = parse_priority(f.priority);
+    e.title = std::move(f.title);
+    e.description = std::move(f.description);
+    e.category = std::move(f.category);
+    e.slot = _make_slot(f.start_time, f.duration, f.time, e.is_schedule());
+    e.leads = _make_leads(f.reminders);
+    if (f.repetition == "Daily") {
+        e.rule = DailyRule{_make_span(f)};
+    } else if (f.repetition == "Weekly") {
+        e.rule = _make_days(f, Repetition::Weekly);
+    } else if (f.repetition == "Monthly") {
+        e.rule = _make_days(f, Repetition::Monthly);
+    } else if (f.repetition == "Yearly") {
+        e.rule = _make_days(f, Repetition::Yearly);
+    } else if (f.repetition == "Custom") {
+        CustomRule rule;
+        rule.same_time_each_day = f.same_time_each_day;
+        for (auto& sub : f.subevents) {
+            Subevent s;
+            s.date = Date::parse(sub.date).pack();
+            s.completed = sub.completed;
+            if (!rule.same_time_each_day) s.slot = _make_slot(sub.start_time, sub.duration, sub.time, e.is_schedule());
+            rule.subevents.push_back(s);
+        }
+        // kept sorted by date and time, with one entry per date when they
+        // share a time
+        auto& subs = rule.subevents;
+        std::stable_sort(subs.begin(), subs.end(), [](const Subevent& a, const Subevent& b) {
+            if (a.date != b.date) return a.date < b.date;
+            return a.slot.start < b.slot.start;
+        });
+        if (rule.same_time_each_day) {
+            subs.erase(std::unique(subs.begin(), subs.end(), [](const Subevent& a, const Subevent& b) {
+                return a.date == b.date;
+            }), subs.end());
+        }
+        e.rule = std::move(rule);
+    } else {
+        e.rule = OnceRule{Date::parse(f.date).pack(), f.completed};
+    }
+    return e;
+}
+
+void _get_string(const json& j, const char* key, std::string& out) {
+    auto it = j.find(key);
+    if (it != j.end() && it->is_string()) out = it->get<std::string>();
+}
+void _get_bool(const json& j, const char* key, bool& out) {
+    auto it = j.find(key);
+    if (it != j.end() && it->is_boolean()) out = it->get<bool>();
+}
+
+Event decode_event(const json& j) {
+    EventFields f;
+    f.id = j.value("id", 0);
+    for (auto [key, out] : {std::pair{"type", &f.type}, {"priority", &f.priority}, {"title", &f.title},
+                            {"description", &f.description}, {"category", &f.category}, {"repetition", &f.repetition},
+                            {"start_time", &f.start_time}, {"duration", &f.duration}, {"time", &f.time},
+                            {"date", &f.date}, {"start_date", &f.start_date}, {"end_date", &f.end_date}}) {
+        _get_string(j, key, *out);
+    }
+    _get_bool(j, "completed", f.completed);
+    _get_bool(j, "same_time_each_day", f.same_time_each_day);
+    auto completed = j.find("completed");
+    if (completed != j.end() && completed->is_array()) f.completed_list = *completed;
+    auto banned = j.find("banned");
+    if (banned != j.end() && banned->is_array()) {
+        for (auto& ban : *banned) {
+            f.banned.emplace_back();
+            _get_string(ban, "l", f.banned.back().first);
+            _get_string(ban, "r", f.banned.back().second);
+        }
+    }
+    auto days = j.find("enabled_days");
+    if (days != j.end() && days->is_array()) {
+        for (auto& x : *days) {
+            if (x.is_string()) f.yearly_days.push_back(x.get<std::string>());
+            if (x.is_number_integer()) f.enabled_days.push_back(x.get<int>());
+        }
+    }
+    auto reminders = j.find("reminders");
+    if (reminders != j.end() && reminders->is_array()) {
+        for (auto& x : *reminders) {
+            if (x.is_string()) f.reminders.push_back(x.get<std::string>());
+        }
+    }
+    auto subevents = j.find("subevents");
+    if (subevents != j.end() && subevents->is_array()) {
+        for (auto& sub : *subevents) {
+            SubeventFields s;
+            _get_string(sub, "date", s.date);
+            _get_string(sub, "start_time", s.start_time);
+            _get_string(sub, "duration", s.duration);
+            _get_string(sub, "time", s.time);
+            _get_bool(sub, "completed", s.completed);
+            f.subevents.push_back(std::move(s));
+        }
+    }
+    return build_event(f);
+}
+
+json encode_event(const Event& e) {
+    json j;
+    j["id"] = e.id;
+    j["type"] = dump(e.type);
+    j["priority"] = dump(e.priority);
+    j["title"] = e.title;
+    j["description"] = e.description;
+    j["category"] = e.category;
+    j["repetition"] = dump(e.repetition());
+    if (auto x = std::get_if<OnceRule>(&e.rule)) {
+        j["date"] = Date::unpack(x->date).dump();
+        j["completed"] = x->completed;
+    } else if (auto x = std::get_if<CustomRule>(&e.rule)) {
+        j["same_time_each_day"] = x->same_time_each_day;
+        j["subevents"] = json::array();
+        for (auto& s : x->subevents) {
+            json sub;
+            sub["date"] = Date::unpack(s.date).dump();
+            sub["completed"] = s.completed;
+            if (!x->same_time_each_day) _put_slot(sub, s.slot, e.is_schedule());
+            j["subevents"].push_back(sub);
+        }
+    } else {
+        _put_span(j, *e.span());
+        if (e.has_enabled_days()) {
+            j["enabled_days"] = json::array();
+            for (int d : e.enabled_day_list()) {
+                if (e.repetition() == Repetition::Yearly) j["enabled_days"].push_back(DateWithoutYear::unpack(d).dump());
+                else j["enabled_days"].push_back(d);
+            }
+        }
+    }
+    if (auto x = std::get_if<CustomRule>(&e.rule); !x || x->same_time_each_day) _put_slot(j, e.slot, e.is_schedule());
+    if (!e.leads.empty()) {
+        j["reminders"] = json::array();
+        for (int x : e.leads) j["reminders"].push_back(Duration{x}.dump());
+    }
+    return j;
+}
+
+// hash of all the fields of an event, to tell whether it changed between two
+// loads without encoding it
+size_t content_hash(const Event& e) {
+    size_t h = 0;
+    auto mix = [&](size_t x) { h ^= x + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+    auto mix_slot = [&](const Slot& s) {
+        mix(s.start);
+        mix(s.duration);
+    };
+    auto mix_span = [&](const Span& s) {
+        mix(s.start_date);
+        mix(s.end_date);
+        for (auto& [l, r] : s.banned) {
+            mix(l);
+            mix(r);
+        }
+        mix(std::hash<json>{}(s.completed));
+    };
+    auto mix_mask = [&](const auto& m) {
+        for (auto w : m.words) mix(w);
+    };
+    mix(e.id);
+    mix(size_t(e.type));
+    mix(size_t(e.priority));
+    for (auto* s : {&e.title, &e.description, &e.category}) mix(std::hash<std::string>{}(*s));
+    mix_slot(e.slot);
+    mix(e.rule.index());
+    if (auto x = std::get_if<OnceRule>(&e.rule)) {
+        mix(x->date);
+        mix(x->completed);
+    } else if (auto x = std::get_if<CustomRule>(&e.rule)) {
+        mix(x->same_time_each_day);
+        for (auto& s : x->subevents) {
+            mix(s.date);
+            mix(s.completed);
+            mix_slot(s.slot);
+        }
+    } else {
+        mix_span(*e.span());
+        if (auto x = std::get_if<WeeklyRule>(&e.rule)) mix_mask(x->enabled_days);
+        else if (auto x = std::get_if<MonthlyRule>(&e.rule)) mix_mask(x->enabled_days);
+        else if (auto x = std::get_if<YearlyRule>(&e.rule)) mix_mask(x->enabled_days);
+    }
+    for (int x : e.leads) mix(x);
+    return h;
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include "event.hpp"
+
+// SAX handler for data.json: events are decoded straight into Event as the
+// parser walks the input, without building a DOM of the whole file. Only the
+// fields of the event currently being read are staged (in EventFields), and an
+// unknown key is skipped whatever its value is.
+class EventSaxLoader : public nlohmann::json_sax<json> {
+public:
+    std::vector<Event> events;
+    int total = 0;
+    int version = 0;
+    std::map<int, int> changes;  // "changes": {"id": version}
+    bool sorted = true;  // whether events came in ascending id order
+    std::string error;   // set when the input is not valid json
+
+    bool null() override { return other(json()); }
+    bool boolean(bool val) override {
+        switch (top()) {
+        case Frame::Event:
+            if (cur_key == "completed") fields.completed = val;
+            else if (cur_key == "same_time_each_day") fields.same_time_each_day = val;
+            return true;
+        case Frame::Subevent:
+            if (cur_key == "completed") fields.subevents.back().completed = val;
+            return true;
+        default:
+            return other(json(val));
+        }
+    }
+    bool number_integer(number_integer_t val) override { return integer(val); }
+    bool number_unsigned(number_unsigned_t val) override { return integer((int64_t)val); }
+    bool number_float(number_float_t val, const string_t&) override { return other(json(val)); }
+    bool string(string_t& val) override {
+        switch (top()) {
+        case Frame::Event:
+            if (auto out = event_string()) *out = std::move(val);
+            return true;
+        case Frame::Ban:
+            if (cur_key == "l") fields.banned.back().first = std::move(val);
+            else if (cur_key == "r") fields.banned.back().second = std::move(val);
+            return true;
+        case Frame::Days:
+            fields.yearly_days.push_back(std::move(val));
+            return true;
+        case Frame::Reminders:
+            fields.reminders.push_back(std::move(val));
+            return true;
+        case Frame::Subevent: {
+            auto& sub = fields.subevents.back();
+            if (cur_key == "date") sub.date = std::move(val);
+            else if (cur_key == "start_time") sub.start_time = std::move(val);
+            else if (cur_key == "duration") sub.duration = std::move(val);
+            else if (cur_key == "time") sub.time = std::move(val);
+            return true;
+        }
+        default:
+            return other(json(std::move(val)));
+        }
+    }
+    bool binary(binary_t&) override { return other(json()); }
+
+    bool start_object(std::size_t) override {
+        switch (top()) {
+        case Frame::None: return push(Frame::Root);
+        case Frame::Root:
+            if (cur_key == "changes") return push(Frame::Changes);
+            return push(Frame::Skip);
+        case Frame::Events:
+            fields = EventFields();
+            return push(Frame::Event);
+        case Frame::Banned:
+            fields.banned.emplace_back();
+            return push(Frame::Ban);
+        case Frame::Subevents:
+            fields.subevents.emplace_back();
+            return push(Frame::Subevent);
+        case Frame::Capture:
+            return open(json::object());
+        default:
+            return push(Frame::Skip);
+        }
+    }
+    bool end_object() override {
+        if (top() == Frame::Capture) return close();
+        if (top() == Frame::Event) {
+            if (!events.empty() && fields.id < events.back().id) sorted = false;
+            events.push_back(build_event(fields));
+        }
+        stack.pop_back();
+        return true;
+    }
+    bool start_array(std::size_t) override {
+        Frame frame = top();
+        if (frame == Frame::Root && cur_key == "events") return push(Frame::Events);
+        if (frame == Frame::Event) {
+            if (cur_key == "banned") return push(Frame::Banned);
+            if (cur_key == "enabled_days") return push(Frame::Days);
+            if (cur_key == "subevents") return push(Frame::Subevents);
+            if (cur_key == "reminders") return push(Frame::Reminders);
+            if (cur_key == "completed") {
+                fields.completed_list = json::array();
+                capture.clear();
+                capture.push_back(&fields.completed_list);
+                return push(Frame::Capture);
+            }
+        }
+        if (frame == Frame::Capture) return open(json::array());
+        return push(Frame::Skip);
+    }
+    bool end_array() override {
+        if (top() == Frame::Capture && capture.size() > 1) return close();
+        stack.pop_back();
+        return true;
+    }
+    bool key(string_t& val) override {
+        if (top() == Frame::Capture) capture_key = val;
+        else cur_key = std::move(val);
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        error = ex.what();
+        return false;
+    }
+
+private:
+    enum class Frame { None, Root, Changes, Events, Event, Banned, Ban, Days, Subevents, Subevent, Reminders, Capture, Skip };
+    std::vector<Frame> stack;
+    string_t cur_key, capture_key;
+    EventFields fields;
+    std::vector<json*> capture;  // open containers inside an opaque "completed" array
+
+    Frame top() const { return stack.empty() ? Frame::None : stack.back(); }
+    bool push(Frame frame) {
+        stack.push_back(frame);
+        return true;
+    }
+    std::string* event_string() {
+        if (cur_key == "type") return &fields.type;
+        if (cur_key == "priority") return &fields.priority;
+        if (cur_key == "title") return &fields.title;
+        if (cur_key == "description") return &fields.description;
+        if (cur_key == "category") return &fields.category;
+        if (cur_key == "repetition") return &fields.repetition;
+        if (cur_key == "start_time") return &fields.start_time;
+        if (cur_key == "duration") return &fields.duration;
+        if (cur_key == "time") return &fields.time;
+        if (cur_key == "date") return &fields.date;
+        if (cur_key == "start_date") return &fields.start_date;
+        if (cur_key == "end_date") return &fields.end_date;
+        return nullptr;
+    }
+    bool integer(int64_t val) {
+        switch (top()) {
+        case Frame::Root:
+            if (cur_key == "total") total = (int)val;
+            else if (cur_key == "version") version = (int)val;
+            return true;
+        case Frame::Changes:
+            changes[std::atoi(cur_key.c_str())] = (int)val;
+            return true;
+        case Frame::Event:
+            if (cur_key == "id") fields.id = (int)val;
+            return true;
+        case Frame::Days:
+            fields.enabled_days.push_back((int)val);
+            return true;
+        default:
+            return other(json(val));
+        }
+    }
+    // values that only matter inside "completed"
+    bool other(json val) {
+        if (top() != Frame::Capture) return true;
+        json& parent = *capture.back();
+        if (parent.is_object()) parent[capture_key] = std::move(val);
+        else parent.push_back(std::move(val));
+        return true;
+    }
+    bool open(json val) {
+        json& parent = *capture.back();
+        if (parent.is_object()) {
+            capture.push_back(&(parent[capture_key] = std::move(val)));
+        } else {
+            parent.push_back(std::move(val));
+            capture.push_back(&parent.back());
+        }
+        return true;
+    }
+    bool close() {
+        capture.pop_back();
+        return true;
+    }
+};
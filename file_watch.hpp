@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Waits for changes to a few files of the working directory. Linux watches the
+// directory with inotify, Windows with a change notification handle, anything
+// else polls every FILE_WATCH_POLL_MS. In all cases the files' modification
+// time and size decide whether something changed, so writes to unrelated files
+// and replacing a file by rename are handled alike. A burst of writes (journal
+// and index of one save) is reported once it has been quiet for
+// FILE_WATCH_QUIET_MS.
+//
+// Deadlines are wall-clock instants rather than timeouts: a relative timeout
+// stops counting while the machine is suspended, while an absolute timer
+// (timerfd on Linux, a waitable timer on Windows) fires on resume and also
+// notices when the clock is set.
+const int FILE_WATCH_POLL_MS = 200;
+const int FILE_WATCH_QUIET_MS = 30;
+
+class FileWatch {
+public:
+    explicit FileWatch(std::vector<std::string> files) : files(std::move(files)) {
+        stamps = scan();
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MODIFY) < 0) {
+            close(fd);
+            fd = -1;
+        }
+        timer = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer < 0 && fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+#elif defined(_WIN32)
+        handle = FindFirstChangeNotificationA(".", FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+        timer = CreateWaitableTimerA(NULL, TRUE, NULL);
+        if (timer == NULL && handle != INVALID_HANDLE_VALUE) {
+            FindCloseChangeNotification(handle);
+            handle = INVALID_HANDLE_VALUE;
+        }
+#endif
+    }
+    ~FileWatch() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+        if (timer >= 0) close(timer);
+#elif defined(_WIN32)
+        if (handle != INVALID_HANDLE_VALUE) FindCloseChangeNotification(handle);
+        if (timer != NULL) CloseHandle(timer);
+#endif
+    }
+    FileWatch(const FileWatch&) = delete;
+    FileWatch& operator=(const FileWatch&) = delete;
+
+    // blocks until deadline at the latest; true if a watched file changed
+    // since the last call. May return false early on unrelated activity or
+    // when the clock is set.
+    bool wait_until(std::chrono::system_clock::time_point deadline) {
+        if (changed()) return true;
+        if (deadline <= std::chrono::system_clock::now()) return false;
+#ifdef __linux__
+        if (fd >= 0) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+            itimerspec spec{};
+            spec.it_value.tv_sec = ns / 1000000000;
+            spec.it_value.tv_nsec = ns % 1000000000;
+            timerfd_settime(timer, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL);
+            pollfd p[2] = {{fd, POLLIN, 0}, {timer, POLLIN, 0}};
+            if (poll(p, 2, -1) <= 0 || !(p[0].revents & POLLIN)) return false;
+            while (readable(FILE_WATCH_QUIET_MS)) {}
+            return changed();
+        }
+#elif defined(_WIN32)
+        if (handle != INVALID_HANDLE_VALUE) {
+            // FILETIME: 100 ns steps since 1601-01-01 UTC
+            auto ticks = std::chrono::duration_cast<std::chrono::microseconds>(deadline.time_since_epoch()).count() * 10 + 116444736000000000LL;
+            LARGE_INTEGER due;
+            due.QuadPart = ticks;
+            SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE);
+            HANDLE both[2] = {handle, timer};
+            if (WaitForMultipleObjects(2, both, FALSE, INFINITE) != WAIT_OBJECT_0) return false;
+            do {
+                FindNextChangeNotification(handle);
+            } while (WaitForSingleObject(handle, FILE_WATCH_QUIET_MS) == WAIT_OBJECT_0);
+            return changed();
+        }
+#endif
+        while (std::chrono::system_clock::now() < deadline) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::system_clock::now()).count();
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::clamp<long long>(left, 0, FILE_WATCH_POLL_MS)));
+            if (changed()) return true;
+        }
+        return false;
+    }
+    // takes the current state as seen, e.g. after writing a watched file
+    void rescan() { stamps = scan(); }
+    // true if a watched file changed since the last check, without waiting
+    bool changed() {
+        auto cur = scan();
+        bool res = false;
+        for (size_t i = 0; i < cur.size(); ++i) res |= cur[i] != stamps[i];
+        stamps = std::move(cur);
+        return res;
+    }
+
+private:
+    struct Stamp {
+        std::filesystem::file_time_type time;
+        long long size;  // -1 if the file is missing
+        bool operator!=(const Stamp& other) const { return time != other.time || size != other.size; }
+    };
+    std::vector<std::string> files;
+    std::vector<Stamp> stamps;
+#ifdef __linux__
+    int fd = -1;
+    int timer = -1;
+
+    // waits for inotify events and drains them
+    bool readable(long long timeout_ms) {
+        pollfd p{fd, POLLIN, 0};
+        if (poll(&p, 1, (int)std::min<long long>(timeout_ms, INT_MAX)) <= 0) return false;
+        char buf[4096];
+        while (read(fd, buf, sizeof(buf)) > 0) {}
+        return true;
+    }
+#elif defined(_WIN32)
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE timer = NULL;
+#endif
+
+    std::vector<Stamp> scan() const {
+        std::vector<Stamp> res;
+        for (auto& name : files) {
+            std::error_code ec;
+            Stamp s{std::filesystem::last_write_time(name, ec), -1};
+            if (!ec) s.size = std::filesystem::file_size(name, ec);
+            if (ec) s = Stamp{std::filesystem::file_time_type(), -1};
+            res.push_back(s);
+        }
+        return res;
+    }
+};
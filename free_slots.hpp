@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "agenda.hpp"
+#include "conflict.hpp"
+#include "event.hpp"
+
+// Free time between schedule occurrences. The busy intervals come out of
+// Agenda in start order, so their union is a single pass that keeps the
+// furthest end seen so far; every gap before the next start is cut down to the
+// daily window, if any, and reported if it is long enough. The cost follows the
+// number of occurrences in the range (plus one step per day of a gap when a
+// window is given), not the size of the calendar.
+//
+// All times are absolute minutes since 1970-01-01 00:00, as in ScheduleTime.
+// report(begin, end) is called in order for each free slot and returns false
+// to stop the search.
+template <class F>
+void find_free(const std::vector<Event>& events, long long begin, long long end, int min_length, int window_l, int window_r, F report) {
+    bool stopped = false;
+    bool whole_day = window_l == 0 && window_r == 1440;  // gaps may then run across midnight
+    auto gap = [&](long long l, long long r) {
+        if (whole_day) {
+            if (r - l >= min_length && !report(l, r)) stopped = true;
+            return;
+        }
+        for (long long day = l / 1440; !stopped && day * 1440 < r; ++day) {
+            long long a = std::max(l, day * 1440 + window_l), b = std::min(r, day * 1440 + window_r);
+            if (b - a >= min_length && !report(a, b)) stopped = true;
+        }
+    };
+    long long cursor = begin;
+    // one day earlier for schedules that run past midnight into the range
+    Agenda merged(events, int(begin / 1440 - 1), int((end - 1) / 1440));
+    Agenda::Item item;
+    while (!stopped && merged.next(item)) {
+        if (!_has_time(*item.event, item.occ.slot)) continue;
+        ScheduleTime x{item.event, item.occ};
+        if (x.begin() >= end) break;
+        if (x.begin() > cursor) gap(cursor, x.begin());
+        cursor = std::max(cursor, x.end());
+    }
+    if (!stopped && cursor < end) gap(cursor, end);
+}
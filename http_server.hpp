@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+#include "socket.hpp"
+
+using json = nlohmann::json;
+
+// Minimal HTTP/1.1 server for the local API of the reminder server. One thread
+// polls the listening socket and every open connection, so an idle client
+// costs a socket rather than a thread. Each request is answered once and the
+// connection closed, except for Server-Sent Events streams: those stay open
+// and receive whatever broadcast() sends, plus a comment line every
+// HTTP_PING_MS so that proxies keep them and dead peers are noticed. A stream
+// whose reader falls HTTP_MAX_BACKLOG bytes behind is dropped; EventSource
+// reconnects by itself. The calendar page is served from elsewhere (python -m
+// http.server, LiveServer, or a file:// page, whose origin is "null"), so
+// cross-origin reads are allowed, but only for the origins in
+// HTTP_DEFAULT_ORIGINS and those added with allow_origin(): any other site
+// open in the browser gets 403 instead of the user's events.
+
+const size_t HTTP_MAX_REQUEST = 16 * 1024;
+const size_t HTTP_MAX_BACKLOG = 256 * 1024;
+const int HTTP_PING_MS = 30000;
+// file://, python -m http.server 8000 and LiveServer, as the README runs them
+const std::vector<std::string> HTTP_DEFAULT_ORIGINS = {"null", "http://localhost:8000", "http://127.0.0.1:8000", "http://localhost:5500", "http://127.0.0.1:5500"};
+
+struct HttpRequest {
+    std::string method, path;
+    std::map<std::string, std::string> query;  // percent-decoded
+    std::string origin;  // Origin header, "" for requests not made by a page of another origin
+};
+struct HttpResponse {
+    int status = 200;
+    std::string body;
+    std::string content_type = "application/json";
+    bool stream = false;  // keep the connection as an event stream, body is its first chunk
+};
+
+std::string _url_decode(std::string_view s) {
+    std::string res;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '+') {
+            res += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char)s[i + 1]) && isxdigit((unsigned char)s[i + 2])) {
+            res += (char)std::stoi(std::string(s.substr(i + 1, 2)), nullptr, 16);
+            i += 2;
+        } else {
+            res += s[i];
+        }
+    }
+    return res;
+}
+// request line, query and Origin of a complete request head, false if malformed
+bool _parse_request(const std::string& head, HttpRequest& req) {
+    size_t line_end = head.find("\r\n");
+    for (size_t l = line_end; l != std::string::npos;) {
+        size_t r = head.find("\r\n", l + 2);
+        std::string_view line = std::string_view(head).substr(l + 2, r == std::string::npos ? r : r - l - 2);
+        l = r;
+        // the one header looked at
+        if (line.size() < 7 || line[6] != ':') continue;
+        std::string name(line.substr(0, 6));
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+        if (name != "origin") continue;
+        line.remove_prefix(7);
+        while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
+        while (!line.empty() && (line.back() == ' ' || line.back() == '\t')) line.remove_suffix(1);
+        req.origin = std::string(line);
+    }
+    size_t a = head.find(' '), b = a == std::string::npos ? a : head.find(' ', a + 1);
+    if (b == std::string::npos || b > line_end) return false;
+    req.method = head.substr(0, a);
+    std::string target = head.substr(a + 1, b - a - 1);
+    size_t q = target.find('?');
+    req.path = _url_decode(target.substr(0, q));
+    if (q == std::string::npos) return true;
+    std::string_view query(target);
+    query.remove_prefix(q + 1);
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        auto pair = query.substr(0, amp);
+        size_t eq = pair.find('=');
+        req.query[_url_decode(pair.substr(0, eq))] = eq == std::string_view::npos ? "" : _url_decode(pair.substr(eq + 1));
+        if (amp == std::string_view::npos) break;
+        query.remove_prefix(amp + 1);
+    }
+    return true;
+}
+const char* _status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    default: return "Internal Server Error";
+    }
+}
+// origin is the allowed Origin of the request, "" if it had none
+std::string _serialize(const HttpResponse& res, const std::string& origin) {
+    std::string cors = origin.empty() ? "" : "Access-Control-Allow-Origin: " + origin + "\r\nVary: Origin\r\n";
+    if (res.stream) {
+        return "HTTP/1.1 " + std::to_string(res.status) + " " + _status_text(res.status) + "\r\n" +
+               "Content-Type: text/event-stream\r\n"
+               "Cache-Control: no-cache\r\n" + cors + "\r\n" + res.body;
+    }
+    return "HTTP/1.1 " + std::to_string(res.status) + " " + _status_text(res.status) + "\r\n" +
+           "Content-Type: " + res.content_type + "\r\n" +
+           "Content-Length: " + std::to_string(res.body.size()) + "\r\n" + cors +
+           "Connection: close\r\n\r\n" + res.body;
+}
+
+class HttpServer {
+public:
+    using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+    explicit HttpServer(Handler handler) : handler(std::move(handler)) {}
+    ~HttpServer() { stop(); }
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // listens on 127.0.0.1:port and starts serving; false if the port is taken
+    bool start(int port) {
+        listener = listen_local(port);
+        if (listener == NO_SOCKET || !open_waker()) return false;
+        worker = std::thread([this] { run(); });
+        return true;
+    }
+    // queues one event for every open stream; callable from any thread
+    void broadcast(const std::string& event, const std::string& data) {
+        if (!worker.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outbox += "event: " + event + "\ndata: " + data + "\n\n";
+        }
+        wake();
+    }
+    // lets pages of origin (scheme://host[:port]) read the API, besides HTTP_DEFAULT_ORIGINS
+    void allow_origin(const std::string& origin) { origins.push_back(origin); }
+    void stop() {
+        if (!worker.joinable()) return;
+        stopping = true;
+        wake();
+        worker.join();
+        for (auto& c : clients) close_socket(c.s);
+        clients.clear();
+        close_socket(listener);
+        close_socket(waker);
+    }
+
+private:
+    struct Client {
+        socket_t s;
+        std::string in, out;
+        size_t sent = 0;
+        bool done = false;
+        bool stream = false;
+    };
+    Handler handler;
+    std::vector<std::string> origins = HTTP_DEFAULT_ORIGINS;
+    socket_t listener = NO_SOCKET;
+    socket_t waker = NO_SOCKET;  // udp socket connected to itself, to interrupt poll
+    std::vector<Client> clients;
+    std::mutex mutex;    // guards outbox
+    std::string outbox;  // events not yet handed to the streams
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+    bool open_waker() {
+        waker = socket(AF_INET, SOCK_DGRAM, 0);
+        if (waker == NO_SOCKET) return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(waker, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(waker, (sockaddr*)&addr, &len) != 0 ||
+            connect(waker, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            return false;
+        }
+        set_nonblocking(waker);
+        return true;
+    }
+    void wake() { send(waker, "x", 1, 0); }
+
+    void run() {
+        std::vector<pollfd> fds;
+        auto next_ping = std::chrono::steady_clock::now() + std::chrono::milliseconds(HTTP_PING_MS);
+        while (!stopping) {
+            fds.assign({pollfd{listener, POLLIN, 0}, pollfd{waker, POLLIN, 0}});
+            for (auto& c : clients) fds.push_back(pollfd{c.s, (short)(c.sent < c.out.size() ? POLLOUT : POLLIN), 0});
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_ping - std::chrono::steady_clock::now()).count();
+            if (poll_sockets(fds.data(), fds.size(), (int)std::max<long long>(wait, 0)) < 0) continue;
+            if (fds[1].revents) {
+                char buf[64];
+                while (recv(waker, buf, sizeof(buf), 0) > 0) {}
+            }
+            std::string events;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                events.swap(outbox);
+            }
+            if (std::chrono::steady_clock::now() >= next_ping) {
+                events += ":\n\n";
+                next_ping = std::chrono::steady_clock::now() + std::chrono::milliseconds(HTTP_PING_MS);
+            }
+            if (!events.empty()) {
+                for (auto& c : clients) {
+                    if (c.stream) push(c, events);
+                }
+            }
+            size_t n = clients.size();  // accepted ones join the next round
+            for (size_t i = 0; i < n; ++i) {
+                short ev = fds[i + 2].revents;
+                if (ev & (POLLERR | POLLNVAL)) clients[i].done = true;
+                else if (ev & POLLOUT) flush(clients[i]);
+                else if (ev & (POLLIN | POLLHUP)) receive(clients[i]);
+            }
+            if (fds[0].revents & POLLIN) accept_all();
+            for (auto& c : clients) {
+                if (c.done) close_socket(c.s);
+            }
+            clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& c) { return c.done; }), clients.end());
+        }
+    }
+    void accept_all() {
+        while (true) {
+            socket_t s = accept(listener, NULL, NULL);
+            if (s == NO_SOCKET) return;
+            set_nonblocking(s);
+            Client c;
+            c.s = s;
+            clients.push_back(std::move(c));
+        }
+    }
+    void receive(Client& c) {
+        char buf[4096];
+        auto n = recv(c.s, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            c.done = true;
+            return;
+        }
+        if (c.stream) return;  // nothing more is expected from a stream reader
+        c.in.append(buf, n);
+        size_t end = c.in.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            if (c.in.size() > HTTP_MAX_REQUEST) respond(c, HttpResponse{413, "{\"error\":\"request too large\"}"});
+            return;
+        }
+        HttpRequest req;
+        if (!_parse_request(c.in.substr(0, end), req)) return respond(c, HttpResponse{400, "{\"error\":\"bad request\"}"});
+        if (!req.origin.empty() && std::find(origins.begin(), origins.end(), req.origin) == origins.end()) {
+            return respond(c, HttpResponse{403, "{\"error\":\"origin not allowed\"}"});
+        }
+        if (req.method != "GET") return respond(c, HttpResponse{405, "{\"error\":\"only GET\"}"}, req.origin);
+        try {
+            respond(c, handler(req), req.origin);
+        } catch (const std::exception& ex) {
+            respond(c, HttpResponse{500, json{{"error", ex.what()}}.dump()}, req.origin);
+        }
+    }
+    void respond(Client& c, const HttpResponse& res, const std::string& origin = "") {
+        c.out = _serialize(res, origin);
+        c.stream = res.stream && res.status == 200;
+        flush(c);
+    }
+    void push(Client& c, const std::string& events) {
+        c.out.erase(0, c.sent);
+        c.sent = 0;
+        if (c.out.size() > HTTP_MAX_BACKLOG) {
+            c.done = true;
+            return;
+        }
+        c.out += events;
+        flush(c);
+    }
+    void flush(Client& c) {
+        while (c.sent < c.out.size()) {
+            auto n = send(c.s, c.out.data() + c.sent, (int)(c.out.size() - c.sent), SEND_FLAGS);
+            if (n <= 0) return;  // would block, or failed and poll reports it
+            c.sent += n;
+        }
+        if (!c.stream) c.done = true;
+    }
+};
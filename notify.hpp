@@ -0,0 +1,189 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+#include "socket.hpp"
+
+using json = nlohmann::json;
+
+// Where the reminder server sends its reminders. Every reminder due at the
+// same instant goes out as one Notification, and a Notifier hands them to the
+// sinks on its own thread, so a slow sink never delays the scheduler. The
+// sinks share that thread: the socket ones give up on a peer after
+// NOTIFY_TIMEOUT_MS, so an endpoint that hangs holds up the others and later
+// reminders at most that long.
+
+const int NOTIFY_TIMEOUT_MS = 5000;
+
+struct Notification {
+    std::string time;                // "yyyy-mm-dd hh:mm"
+    std::vector<std::string> lines;  // one per reminder
+    std::string text() const {
+        std::string res;
+        for (auto& x : lines) res += x + "\n";
+        return res;
+    }
+    json to_json() const { return json{{"time", time}, {"reminders", lines}}; }
+};
+
+class NotificationSink {
+public:
+    virtual ~NotificationSink() = default;
+    // may block; throws std::runtime_error when delivery failed
+    virtual void deliver(const Notification& n) = 0;
+};
+
+class StdoutSink : public NotificationSink {
+public:
+    void deliver(const Notification& n) override {
+        for (auto& x : n.lines) std::cout << n.time << " " << x << "\n";
+        std::cout.flush();
+    }
+};
+
+class LogFileSink : public NotificationSink {
+public:
+    explicit LogFileSink(std::string path) : path(std::move(path)) {}
+    void deliver(const Notification& n) override {
+        std::ofstream file(path, std::ios::app | std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error("cannot open " + path);
+        for (auto& x : n.lines) file << n.time << " " << x << "\n";
+    }
+
+private:
+    std::string path;
+};
+
+// one json line per notification to a listener on a Unix domain socket
+class UnixSocketSink : public NotificationSink {
+public:
+    explicit UnixSocketSink(std::string path) : path(std::move(path)) {}
+    void deliver(const Notification& n) override {
+        _socket_startup();
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("socket path too long");
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        Connection c(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (c.s == NO_SOCKET || !connect_within(c.s, (sockaddr*)&addr, sizeof(addr), NOTIFY_TIMEOUT_MS)) {
+            throw std::runtime_error("cannot connect to " + path);
+        }
+        set_timeouts(c.s, NOTIFY_TIMEOUT_MS);
+        c.send_all(n.to_json().dump() + "\n");
+    }
+
+private:
+    std::string path;
+};
+
+// POSTs the notification as json to http://host:port/path
+class HttpPostSink : public NotificationSink {
+public:
+    // false if url is not of the form http://host[:port][/path]
+    bool parse(const std::string& url) {
+        const std::string scheme = "http://";
+        if (url.compare(0, scheme.size(), scheme) != 0) return false;
+        std::string rest = url.substr(scheme.size());
+        size_t slash = rest.find('/');
+        path = slash == std::string::npos ? "/" : rest.substr(slash);
+        host = rest.substr(0, slash);
+        port = "80";
+        size_t colon = host.find(':');
+        if (colon != std::string::npos) {
+            port = host.substr(colon + 1);
+            host = host.substr(0, colon);
+        }
+        return !host.empty() && !port.empty();
+    }
+    void deliver(const Notification& n) override {
+        _socket_startup();
+        addrinfo hints{}, *res = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) throw std::runtime_error("cannot resolve " + host);
+        Connection c;
+        for (auto p = res; p && c.s == NO_SOCKET; p = p->ai_next) {
+            socket_t s = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (s == NO_SOCKET) continue;
+            if (connect_within(s, p->ai_addr, (socklen_t)p->ai_addrlen, NOTIFY_TIMEOUT_MS)) c.s = s;
+            else close_socket(s);
+        }
+        freeaddrinfo(res);
+        if (c.s == NO_SOCKET) throw std::runtime_error("cannot connect to " + host + ":" + port);
+        set_timeouts(c.s, NOTIFY_TIMEOUT_MS);
+        std::string body = n.to_json().dump();
+        c.send_all("POST " + path + " HTTP/1.1\r\nHost: " + host + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+        std::string status = c.receive_some();
+        if (status.compare(0, 7, "HTTP/1.") != 0 || status.size() < 12 || status[9] != '2') {
+            throw std::runtime_error("POST " + path + ": " + status.substr(0, status.find('\r')));
+        }
+    }
+
+private:
+    std::string host, port, path;
+};
+
+// delivers notifications to every sink on a background thread, in the order
+// they were posted; a failing sink is reported and skipped
+class Notifier {
+public:
+    Notifier() : worker([this] { run(); }) {}
+    ~Notifier() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        worker.join();
+    }
+    Notifier(const Notifier&) = delete;
+    Notifier& operator=(const Notifier&) = delete;
+
+    // call before the first post
+    void add(std::unique_ptr<NotificationSink> sink) { sinks.push_back(std::move(sink)); }
+    bool empty() const { return sinks.empty(); }
+    void post(Notification n) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(n));
+        }
+        ready.notify_one();
+    }
+
+private:
+    std::vector<std::unique_ptr<NotificationSink>> sinks;
+    std::deque<Notification> pending;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+    std::thread worker;  // last, so it starts after everything above exists
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            Notification n = std::move(pending.front());
+            pending.pop_front();
+            lock.unlock();
+            for (auto& sink : sinks) {
+                try {
+                    sink->deliver(n);
+                } catch (const std::exception& ex) {
+                    std::cerr << "Reminder not delivered: " << ex.what() << "\n";
+                }
+            }
+            lock.lock();
+        }
+    }
+};
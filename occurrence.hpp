@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <vector>
+#include "calendar.hpp"
+#include "event.hpp"
+
+// Occurrences of an event between two packed dates, generated lazily in date
+// order. Every step seeks straight to the next enabled day of the rule and
+// jumps over banned intervals, so walking a range costs O(occurrences) rather
+// than O(days). The reminder server, the CLI and anything else asking "when
+// does this event happen" go through here.
+
+struct Occurrence {
+    int date;   // packed
+    Slot slot;  // the subevent's own slot for Custom rules without same_time_each_day
+};
+
+// whether the Daily/Weekly/Monthly/Yearly rule of e enables the day, ignoring
+// its span and bans
+bool day_enabled(const Event& e, int day) {
+    if (auto x = std::get_if<WeeklyRule>(&e.rule)) return x->enabled_days.test(weekday_from_days(day));
+    if (auto x = std::get_if<MonthlyRule>(&e.rule)) return x->enabled_days.test(civil_from_days(day).day);
+    if (auto x = std::get_if<YearlyRule>(&e.rule)) {
+        auto c = civil_from_days(day);
+        return x->enabled_days.test(year_slot(c.month, c.day));
+    }
+    return e.repetition() == Repetition::Daily;
+}
+// first day >= day enabled by the rule of e, INT_MAX if there is none
+int next_enabled_day(const Event& e, int day) {
+    if (auto x = std::get_if<WeeklyRule>(&e.rule)) {
+        if (!x->enabled_days.count()) return INT_MAX;
+        int w = weekday_from_days(day);
+        int next = x->enabled_days.next(w);
+        if (next < 0) next = x->enabled_days.next(0) + 7;
+        return day + next - w;
+    }
+    if (auto x = std::get_if<MonthlyRule>(&e.rule)) {
+        if (!x->enabled_days.count()) return INT_MAX;
+        // any day of month shows up again within a year
+        auto d = Date::from_days(day);
+        for (int i = 0; i < 12; ++i) {
+            int next = x->enabled_days.next(d.day);
+            if (next >= 0 && next <= get_month_day(d.year, d.month)) return Date{d.year, d.month, next}.to_days();
+            d = d.month == 12 ? Date{d.year + 1, 1, 1} : Date{d.year, d.month + 1, 1};
+        }
+        return INT_MAX;
+    }
+    if (auto x = std::get_if<YearlyRule>(&e.rule)) {
+        if (!x->enabled_days.count()) return INT_MAX;
+        // 02-29 alone can take 8 years to come back
+        auto d = Date::from_days(day);
+        for (int i = 0; i < 9; ++i) {
+            for (int slot = x->enabled_days.next(year_slot(d.month, d.day)); slot >= 0; slot = x->enabled_days.next(slot + 1)) {
+                auto md = from_year_slot(slot);
+                if (md.day <= get_month_day(d.year, md.month)) return Date{d.year, md.month, md.day}.to_days();
+            }
+            d = Date{d.year + 1, 1, 1};
+        }
+        return INT_MAX;
+    }
+    return e.repetition() == Repetition::Daily ? day : INT_MAX;
+}
+
+// input range over the occurrences of one event in [from, to]; the event must
+// outlive it
+class Occurrences {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Occurrence;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Occurrence*;
+        using reference = const Occurrence&;
+
+        explicit iterator(Occurrences* range = nullptr) : range(range) {}
+        reference operator*() const { return range->cur; }
+        pointer operator->() const { return &range->cur; }
+        iterator& operator++() {
+            range->advance();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return at_end() == other.at_end(); }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        Occurrences* range;
+        bool at_end() const { return !range || range->done; }
+    };
+
+    Occurrences(const Event& e, int from, int to) : event(e), to(to) {
+        if (auto rule = std::get_if<OnceRule>(&e.rule)) {
+            done = rule->date < from || rule->date > to;
+            cur = Occurrence{rule->date, e.slot};
+        } else if (auto rule = std::get_if<CustomRule>(&e.rule)) {
+            // subevents are kept sorted by date
+            pos = std::lower_bound(rule->subevents.begin(), rule->subevents.end(), from, [](const Subevent& a, int b) {
+                return a.date < b;
+            }) - rule->subevents.begin();
+            next_subevent();
+        } else {
+            span = e.span();
+            if (span->end_date != NO_DATE) this->to = std::min(to, span->end_date);
+            seek(std::max(from, span->start_date));
+        }
+    }
+    Occurrences(const Occurrences&) = delete;
+    Occurrences& operator=(const Occurrences&) = delete;
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+private:
+    const Event& event;
+    int to;
+    bool done = false;
+    Occurrence cur{NO_DATE, Slot()};
+    size_t pos = 0;                 // next subevent (Custom)
+    const Span* span = nullptr;     // Daily/Weekly/Monthly/Yearly
+
+    void advance() {
+        if (event.repetition() == Repetition::Once) done = true;
+        else if (event.repetition() == Repetition::Custom) next_subevent();
+        else if (cur.date >= to) done = true;
+        else seek(cur.date + 1);
+    }
+    void next_subevent() {
+        auto& rule = std::get<CustomRule>(event.rule);
+        if (pos >= rule.subevents.size() || rule.subevents[pos].date > to) {
+            done = true;
+            return;
+        }
+        auto& sub = rule.subevents[pos++];
+        cur = Occurrence{sub.date, rule.same_time_each_day ? event.slot : sub.slot};
+    }
+    // first occurrence on or after day
+    void seek(int day) {
+        // INT_MAX stands for "never" in both lookups
+        while (day <= to && day != INT_MAX) {
+            day = next_enabled_day(event, day);
+            if (day > to || day == INT_MAX) break;
+            int allowed = span->banned.next_allowed(day);
+            if (allowed == day) {
+                cur = Occurrence{day, event.slot};
+                return;
+            }
+            day = allowed;
+        }
+        done = true;
+    }
+};
+
+Occurrences occurrences(const Event& e, int from, int to) {
+    return Occurrences(e, from, to);
+}
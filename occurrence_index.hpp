@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "calendar.hpp"
+#include "event.hpp"
+#include "occurrence.hpp"
+
+// Materialized occurrences of every event over a rolling window of days around
+// today, so "what happens on day d" is a lookup instead of a pass over all
+// events. Mutations replace the entries of the events they touch and moving
+// the window only expands the days that enter it. storage.hpp keeps it in
+// data.index.bin:
+//   IndexHeader
+//   IndexRecord[count]   (day, id, start, duration), by day and then time
+// version is the calendar version the entries reflect, so a reader only
+// re-expands the events changed after it (see sync_index()).
+
+const int INDEX_PAST_DAYS = 30;
+const int INDEX_FUTURE_DAYS = 365;
+const uint32_t INDEX_MAGIC = 0x495a4c50;  // "PLZI"
+const uint32_t INDEX_FORMAT = 1;
+
+struct IndexHeader {
+    uint32_t magic, format;
+    int32_t from, to, version;
+    uint32_t count;
+};
+struct IndexRecord {
+    int32_t day, id, start, duration;
+};
+
+struct IndexEntry {
+    int id;
+    Slot slot;
+    bool operator<(const IndexEntry& other) const {
+        if (slot.start != other.slot.start) return slot.start < other.slot.start;
+        return id < other.id;
+    }
+};
+
+int local_today() {
+    time_t now = time(0);
+    return split_date_time(*localtime(&now)).first.pack();
+}
+
+class OccurrenceIndex {
+public:
+    int from = NO_DATE, to = NO_DATE;  // inclusive window, NO_DATE before the first build
+    int version = 0;                   // calendar version of the events it was built from
+
+    // entries of one day ordered by time, empty outside the window
+    const std::vector<IndexEntry>& on(int day) const {
+        static const std::vector<IndexEntry> none;
+        auto it = days.find(day);
+        return it == days.end() ? none : it->second;
+    }
+    // sorted days event id occurs on inside the window
+    const std::vector<int>& days_of(int id) const {
+        static const std::vector<int> none;
+        auto it = event_days.find(id);
+        return it == event_days.end() ? none : it->second;
+    }
+    void rebuild(const std::vector<Event>& events, int today) {
+        days.clear();
+        event_days.clear();
+        from = today - INDEX_PAST_DAYS;
+        to = today + INDEX_FUTURE_DAYS;
+        for (auto& e : events) add(e, from, to);
+    }
+    // replaces the entries of event id with those of e, null if it is gone
+    void update(int id, const Event* e) {
+        auto it = event_days.find(id);
+        if (it != event_days.end()) {
+            for (int day : it->second) erase(day, id);
+            event_days.erase(it);
+        }
+        if (e) add(*e, from, to);
+    }
+    // moves the window to today; false if it was already there
+    bool roll(const std::vector<Event>& events, int today) {
+        int l = today - INDEX_PAST_DAYS, r = today + INDEX_FUTURE_DAYS;
+        if (l == from && r == to) return false;
+        if (from == NO_DATE || l > to || r < from) {
+            rebuild(events, today);
+            return true;
+        }
+        for (auto it = days.begin(); it != days.end();) {
+            if (it->first >= l && it->first <= r) {
+                ++it;
+                continue;
+            }
+            for (auto& entry : it->second) {
+                auto& v = event_days[entry.id];
+                v.erase(std::remove(v.begin(), v.end(), it->first), v.end());
+                if (v.empty()) event_days.erase(entry.id);
+            }
+            it = days.erase(it);
+        }
+        int old_from = from, old_to = to;
+        from = l, to = r;
+        for (auto& e : events) {
+            if (l < old_from) add(e, l, old_from - 1);
+            if (r > old_to) add(e, old_to + 1, r);
+        }
+        return true;
+    }
+
+    bool save(const std::string& filename) const {
+        std::vector<IndexRecord> records;
+        for (auto& [day, entries] : days) {
+            for (auto& entry : entries) records.push_back(IndexRecord{day, entry.id, entry.slot.start, entry.slot.duration});
+        }
+        IndexHeader h{INDEX_MAGIC, INDEX_FORMAT, from, to, version, (uint32_t)records.size()};
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write((const char*)&h, sizeof(h));
+        file.write((const char*)records.data(), records.size() * sizeof(IndexRecord));
+        file.close();
+        return !file.fail();
+    }
+    // false if the file is missing, foreign or truncated
+    bool load(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        std::string data(std::istreambuf_iterator<char>(file), {});
+        IndexHeader h;
+        if (data.size() < sizeof(h)) return false;
+        std::memcpy(&h, data.data(), sizeof(h));
+        if (h.magic != INDEX_MAGIC || h.format != INDEX_FORMAT) return false;
+        if (data.size() != sizeof(h) + (uint64_t)h.count * sizeof(IndexRecord) || h.from == NO_DATE || h.from > h.to) return false;
+        days.clear();
+        event_days.clear();
+        from = h.from, to = h.to, version = h.version;
+        // records come in index order, so appending keeps every list sorted
+        for (uint32_t i = 0; i < h.count; ++i) {
+            IndexRecord r;
+            std::memcpy(&r, data.data() + sizeof(h) + (size_t)i * sizeof(r), sizeof(r));
+            days[r.day].push_back(IndexEntry{r.id, Slot{r.start, r.duration}});
+            auto& v = event_days[r.id];
+            if (v.empty() || v.back() != r.day) v.push_back(r.day);
+        }
+        return true;
+    }
+
+private:
+    std::map<int, std::vector<IndexEntry>> days;
+    std::map<int, std::vector<int>> event_days;  // id -> sorted days it has entries on
+
+    void insert(int day, const IndexEntry& entry) {
+        auto& list = days[day];
+        list.insert(std::upper_bound(list.begin(), list.end(), entry), entry);
+        auto& v = event_days[entry.id];
+        v.insert(std::upper_bound(v.begin(), v.end(), day), day);
+    }
+    void erase(int day, int id) {
+        auto it = days.find(day);
+        if (it == days.end()) return;
+        auto& list = it->second;
+        list.erase(std::remove_if(list.begin(), list.end(), [&](const IndexEntry& x) {
+            return x.id == id;
+        }), list.end());
+        if (list.empty()) days.erase(it);
+    }
+    void add(const Event& e, int l, int r) {
+        for (auto& occ : occurrences(e, l, r)) insert(occ.date, IndexEntry{e.id, occ.slot});
+    }
+};
@@ -5,206 +5,28 @@
 #include <algorithm>
 #include <bitset>
 #include <set>
+#include <sstream>
+#define WIN32_LEAN_AND_MEAN  // keeps winsock.h out of the way of socket.hpp
 #include <windows.h>
 #include "json.hpp"
+#include "calendar.hpp"
+#include "cli_daemon.hpp"
+#include "agenda.hpp"
+#include "conflict.hpp"
+#include "free_slots.hpp"
+#include "event.hpp"
+#include "occurrence.hpp"
+#include "storage.hpp"
 
 using json = nlohmann::json;
 
-bool is_leap_year(int year) {
-    if (year % 400 == 0) return 1;
-    if (year % 100 == 0) return 0;
-    if (year % 4 == 0) return 1;
-    return 0;
-}
-int get_month_day(int year, int month) {
-    if (month == 2) return is_leap_year(year) + 28;
-    if (month < 8) return 30 + month % 2;
-    return 31 - month % 2;
-}
-
-std::string to_string(int x, int n = -1) {
-    std::string res;
-    for (int i = 0; n == -1 ? x : (i < n); ++i) res += char(x % 10 + '0'), x /= 10;
-    std::reverse(res.begin(), res.end());
-    return res;
-}
-int to_uint(std::string s) {
-    int res = 0;
-    for (char c : s) {
-        if (!isdigit(c)) return -1;
-        res = res * 10 + c - '0';
-    }
-    return res;
-}
-std::vector<std::string> split(std::string s, char c) {
-    std::vector<std::string> res{""};
-    for (auto& x : s) {
-        if (x == c) res.push_back("");
-        else res.back() += x;
-    }
-    return res;
-}
-
-struct Date {
-    int year, month, day;
-    static Date parse(std::string s) {
-        auto x = split(s, '-');
-        if (x.size() != 3) return Date{-1, -1, -1};
-        int year = to_uint(x[0]);
-        int month = to_uint(x[1]);
-        int day = to_uint(x[2]);
-        if (year < 1900 || month < 1 || day < 1) return Date{-1, -1, -1};
-        if (month > 12 || day > get_month_day(year, month)) return Date{-1, -1, -1};
-        return Date{year, month, day};
-    }
-    std::string dump() {
-        if (year < 0) return "-1";
-        return to_string(year, 4) + "-" + to_string(month, 2) + "-" + to_string(day, 2);
-    }
-    bool operator<(const Date& other) const {
-        if (year != other.year) return year < other.year;
-        if (month != other.month) return month < other.month;
-        return day < other.day;
-    }
-    bool operator==(const Date& other) const {
-        return year == other.year && month == other.month && day == other.day;
-    }
-};
-struct DateWithoutYear {
-    int month, day;
-    static DateWithoutYear parse(std::string s) {
-        auto x = split(s, '-');
-        if (x.size() != 2) return DateWithoutYear{-1, -1};
-        int month = to_uint(x[0]);
-        int day = to_uint(x[1]);
-        if (month < 1 || day < 1) return DateWithoutYear{-1, -1};
-        if (month > 12 || day > get_month_day(2000, month)) return DateWithoutYear{-1, -1};
-        return DateWithoutYear{month, day};
-    }
-    std::string dump() {
-        if (month < 0) return "-1";
-        return to_string(month, 2) + "-" + to_string(day, 2);
-    }
-    bool operator<(const DateWithoutYear& other) const {
-        if (month != other.month) return month < other.month;
-        return day < other.day;
-    }
-    bool operator==(const DateWithoutYear& other) const {
-        return month == other.month && day == other.day;
-    }
-};
-struct Time {
-    int hour, minute;
-    static Time parse(std::string s) {
-        auto x = split(s, ':');
-        if (x.size() != 2) return Time{-1, -1};
-        int hour = to_uint(x[0]);
-        int minute = to_uint(x[1]);
-        if (hour < 0 || hour > 23 || minute < 0 || minute > 59) return Time{-1, -1};
-        return Time{hour, minute};
-    }
-    std::string dump() {
-        if (minute < 0) return "-1";
-        return to_string(hour, 2) + ":" + to_string(minute, 2);
-    }
-    bool operator<(const Time& other) const {
-        if (other.hour != hour) return hour < other.hour;
-        return minute < other.minute;
-    }
-};
-struct Duration {
-    int minute;
-    static Duration parse(std::string s) {
-        auto x = split(s, ':');
-        if (x.size() == 0) {
-            return Duration{0};
-        }
-        if (x.size() == 1) {
-            return Duration{to_uint(x[0])};
-        }
-        if (x.size() == 2) {
-            int hour = to_uint(x[0]);
-            int minute = to_uint(x[1]);
-            if (hour < 0 || minute < 0 || minute > 59) return Duration{-1};
-            return Duration{hour * 60 + minute};
-        }
-        return Duration{-1};
-    }
-    std::string dump() {
-        return to_string(minute / 60) + ":" + to_string(minute % 60, 2);
-    }
-};
-
-std::tm combine_date_time(Date d, Time t) {
-    std::tm res;
-    res.tm_year = d.year - 1900;
-    res.tm_mon = d.month - 1;
-    res.tm_mday = d.day;
-    res.tm_hour = t.hour;
-    res.tm_min = t.minute;
-    res.tm_sec = 0;
-    res.tm_isdst = -1;
-    return res;
-}
-std::pair<Date, Time> split_date_time(std::tm t) {
-    return {Date{t.tm_year + 1900, t.tm_mon + 1, t.tm_mday}, Time{t.tm_hour, t.tm_min}};
-}
-
-int get_weekday(Date d) {
-    std::tm t = combine_date_time(d, Time{0, 0});
-    std::mktime(&t);
-    return t.tm_wday;
-}
-
-Time operator+(Time a, const Duration& b) {
-    a.minute += b.minute;
-    a.hour += a.minute / 60;
-    a.minute %= 60;
-    a.hour %= 24;
-    return a;
-}
-Time operator-(Time a,const Duration& b){
-    int digit=0;
-    a.minute -= b.minute;
-    while(a.minute<0){
-        a.minute+=60;
-        digit+=1;
-    }
-    a.hour -=digit;
-    while(a.minute<0){
-        a.hour+=24;
-    }
-    return a;
-}
-std::vector<json> events;
-
-std::string read_from_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) return "";
-    std::string res;
-    while (true) {
-        char c = file.get();
-        if (file.eof()) break;
-        res += c;
-    }
-    file.close();
-    return res;
-}
-bool write_to_file(const std::string& filename, const std::string& content) {
-    std::ofstream file(filename);
-    if (!file.is_open()) return true;
-    file << content;
-    file.close();
-    return false;
-}
-
 void _help_all() {
-    printf("  ____   _                       _                  \n");
-    printf(" |  _ \\ | |  __ _  _ __    __ _ | | _   _  ____ ___ \n");
-    printf(" | |_) || | / _` || '_ \\  / _` || || | | ||_  // _ \\\n");
-    printf(" |  __/ | || (_| || | | || (_| || || |_| | / /|  __/\n");
-    printf(" |_|    |_| \\__,_||_| |_| \\__,_||_| \\__, |/___|\\___|\n");
-    printf("                                    |___/           \n");
+    std::cout << "  ____   _                       _                  " << std::endl;
+    std::cout << " |  _ \\ | |  __ _  _ __    __ _ | | _   _  ____ ___ " << std::endl;
+    std::cout << " | |_) || | / _` || '_ \\  / _` || || | | ||_  // _ \\" << std::endl;
+    std::cout << " |  __/ | || (_| || | | || (_| || || |_| | / /|  __/" << std::endl;
+    std::cout << " |_|    |_| \\__,_||_| |_| \\__,_||_| \\__, |/___|\\___|" << std::endl;
+    std::cout << "                                    |___/           " << std::endl;
     std::cout << "Start your journy with Planalyze right now!" << std::endl;
     std::cout << "Usage: " << std::endl;
     std::cout << "  planalyze.exe [--help|-h] (<Command>)     show help for a command or all commands" << std::endl;
@@ -212,6 +34,13 @@ void _help_all() {
     std::cout << "  planalyze.exe [--remove|-r] ...           remove events" << std::endl;
     std::cout << "  planalyze.exe [--list|-l] ...             list events" << std::endl;
     std::cout << "  planalyze.exe [--edit|-e] ...             edit events" << std::endl;
+    std::cout << "  planalyze.exe [--agenda] ...              list occurrences in time order" << std::endl;
+    std::cout << "  planalyze.exe [--conflicts] ...           find overlapping schedules" << std::endl;
+    std::cout << "  planalyze.exe [--free] ...                find free time between schedules" << std::endl;
+    std::cout << "  planalyze.exe [--compact]                 fold the change journal back into data.json" << std::endl;
+    std::cout << "  planalyze.exe [--changes-since] ...       print events changed after a calendar version as json" << std::endl;
+    std::cout << "  planalyze.exe [--batch] ...               apply add/remove/edit operations from a json lines file" << std::endl;
+    std::cout << "  planalyze.exe [--daemon]                  keep the calendar in memory and answer list/agenda/conflicts/free/changes-since" << std::endl;
     //修改help输出
 }
 void _help_add() {
@@ -241,7 +70,43 @@ void _help_edit() {
     std::cout << "  planalyze.exe [--edit|-e] <ID> [--repetition|-r]                         edit the repetition of the event"<< std::endl;
     std::cout << "  planalyze.exe [--edit|-e] <ID> [--detail|-d] <detail1,detail2...>        edit the detail of the event"<< std::endl;
 }
-
+void _help_agenda() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  planalyze.exe [--agenda] [--help|-h]                       show help for this command" << std::endl;
+    std::cout << "  planalyze.exe [--agenda] <FROM> <TO> [--limit <N>]         show every occurrence between the dates, at most N" << std::endl;
+}
+void _help_conflicts() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  planalyze.exe [--conflicts] [--help|-h]                    show help for this command" << std::endl;
+    std::cout << "  planalyze.exe [--conflicts] [FROM] [TO]                    show overlapping schedules, from today and for a year by default" << std::endl;
+}
+void _help_free() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  planalyze.exe [--free] [--help|-h]                                         show help for this command" << std::endl;
+    std::cout << "  planalyze.exe [--free] <DURATION> [FROM] [TO]                              show the earliest free slots of at least DURATION(hh:mm), from now and for a year by default" << std::endl;
+    std::cout << "  planalyze.exe [--free] <DURATION> ... [--within <hh:mm-hh:mm>]             only count the time inside this window of each day" << std::endl;
+    std::cout << "  planalyze.exe [--free] <DURATION> ... [--limit <N>]                        show at most N slots" << std::endl;
+}
+void _help_compact() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  planalyze.exe [--compact] [--help|-h]                      show help for this command" << std::endl;
+    std::cout << "  planalyze.exe [--compact]                                  fold the change journal back into data.json and rewrite data.bin and the day index" << std::endl;
+}
+void _help_changes() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  planalyze.exe [--changes-since] [--help|-h]                show help for this command" << std::endl;
+    std::cout << "  planalyze.exe [--changes-since] <VERSION>                  print the current version, the events changed and the ids removed after VERSION, 0 for everything" << std::endl;
+}
+void _help_batch() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  planalyze.exe [--batch] [--help|-h]                        show help for this command" << std::endl;
+    std::cout << "  planalyze.exe [--batch] [FILE|-]                           apply the operations in FILE, or standard input, with one save" << std::endl;
+    std::cout << "  one json object per line:" << std::endl;
+    std::cout << "    {\"op\":\"add\",\"event\":{...}}                           fields as in data.json, the id is assigned" << std::endl;
+    std::cout << "    {\"op\":\"remove\",\"id\":ID}" << std::endl;
+    std::cout << "    {\"op\":\"edit\",\"id\":ID,\"set\":{...}}                   fields to replace" << std::endl;
+    std::cout << "  prints one json result per line, then a summary" << std::endl;
+}
 
 void _help(std::string s) {
     if (s == "") _help_all();
@@ -249,32 +114,14 @@ void _help(std::string s) {
     else if (s == "remove" || s == "-r" || s == "--remove") _help_remove();
     else if (s == "list" || s == "-l" || s == "--list") _help_list();
     else if (s == "edit" || s == "-e" || s == "--edit") _help_edit();
+    else if (s == "agenda" || s == "--agenda") _help_agenda();
+    else if (s == "conflicts" || s == "--conflicts") _help_conflicts();
+    else if (s == "free" || s == "--free") _help_free();
+    else if (s == "compact" || s == "--compact") _help_compact();
+    else if (s == "changes-since" || s == "--changes-since") _help_changes();
+    else if (s == "batch" || s == "--batch") _help_batch();
     else std::cout << "unknown command: " << s << std::endl;
 }
-int tot;
-
-void read_events() {
-    std::string tmp = read_from_file("data.json");
-    if (tmp == "") tmp = "{}";
-    json data = json::parse(tmp);
-    if (data.size() == 0) {
-        data["total"] = 0;
-        data["events"] = json::array();
-    }
-    tot = data["total"];
-    events = data["events"];
-    std::sort(events.begin(), events.end(), [](const json& a, const json& b) {
-        return a["id"] < b["id"];
-    });
-}
-void save_events() {
-    json data;
-    data["total"] = tot;
-    data["events"] = events;
-    write_to_file("data.json", data.dump(4));
-    write_to_file("update.txt", "1");
-}
-
 void help(int argc, char* argv[]) {
     if (argc == 0) {
         _help_all();
@@ -364,7 +211,7 @@ void get_repetition(json& new_event){
             new_event["same_time_each_day"] = read_yn("Same time every day(Y/N): ");
             if (new_event["same_time_each_day"]==false) {
                 std::cout << "Input the dates of the event(yyyy-mm-dd), ends with 'end': \n";
-                std::set<std::string> dates;
+                std::set<int> dates;
                 int n = 0;
                 while (true) {
                     json tmp;
@@ -374,8 +221,8 @@ void get_repetition(json& new_event){
                         auto tmp = Date::parse(s);
                         if (tmp.year == -1) return false;
                         s = tmp.dump();
-                        if (dates.count(s)) return false;
-                        dates.insert(s);
+                        if (dates.count(tmp.pack())) return false;
+                        dates.insert(tmp.pack());
                         return true;
                     });
                     if (tmp["date"] == "end") break;
@@ -390,7 +237,7 @@ void get_repetition(json& new_event){
                     new_event["subevents"].push_back(tmp);
                 }
             } else {
-                std::set<std::string> dates;
+                std::set<int> dates;
                 int n = 0;
                 while (true) {
                     json tmp;
@@ -400,8 +247,8 @@ void get_repetition(json& new_event){
                         auto tmp = Date::parse(s);
                         if (tmp.year == -1) return false;
                         s = tmp.dump();
-                        if (dates.count(s)) return false;
-                        dates.insert(s);
+                        if (dates.count(tmp.pack())) return false;
+                        dates.insert(tmp.pack());
                         return true;
                     });
                     if (tmp["date"] == "end") break;
@@ -416,14 +263,6 @@ void get_repetition(json& new_event){
                     new_event["time"] = read_time("Time: ").dump();
                 }
             }
-            std::sort(new_event["subevents"].begin(), new_event["subevents"].end(), [](const json& a, const json& b) {
-                return a["date"] < b["date"];
-            });
-            if (new_event["same_time_each_day"]) {
-                new_event["subevents"].erase(std::unique(new_event["subevents"].begin(), new_event["subevents"].end(), [](const json& a, const json& b) {
-                    return a["date"] == b["date"];
-                }), new_event["subevents"].end());
-            }
         } 
     if (new_event["repetition"] == "Once") {
             new_event["date"] = read_date("Date: ").dump();
@@ -440,7 +279,7 @@ void get_repetition(json& new_event){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (new_event["start_time"] != "-1" && s < new_event["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(new_event["start_date"]).pack()) return false;
                 return true;
             });
             new_event["completed"] = json::array();
@@ -470,7 +309,7 @@ void get_repetition(json& new_event){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (new_event["start_time"] != "-1" && s < new_event["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(new_event["start_date"]).pack()) return false;
                 return std::binary_search(new_event["enabled_days"].begin(), new_event["enabled_days"].end(), get_weekday(Date::parse(s)));
             });
             new_event["completed"] = json::array();
@@ -500,7 +339,7 @@ void get_repetition(json& new_event){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (new_event["start_time"] != "-1" && s < new_event["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(new_event["start_date"]).pack()) return false;
                 return std::binary_search(new_event["enabled_days"].begin(), new_event["enabled_days"].end(), Date::parse(s).day);
             });
             new_event["completed"] = json::array();
@@ -530,13 +369,37 @@ void get_repetition(json& new_event){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (new_event["start_time"] != "-1" && s < new_event["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(new_event["start_date"]).pack()) return false;
                 return std::binary_search(new_event["enabled_days"].begin(), new_event["enabled_days"].end(), s.substr(5, 5));
             });
             new_event["completed"] = json::array();
             new_event["banned"] = json::array();
         }
 }
+bool save_failed;  // makes the exit status 1
+// save_events(), telling the user if the change did not reach the disk
+bool _save() {
+    if (save_events()) return true;
+    std::cout << "Cannot write the data files, the change is not saved.\n";
+    save_failed = true;
+    return false;
+}
+std::string _occurrence_line(const Event& e, const Occurrence& occ) {
+    std::string res = Date::unpack(occ.date).dump() + " " + Time::unpack(occ.slot.start).dump();
+    if (e.is_schedule()) res += "-" + Time::unpack(occ.slot.end()).dump();
+    return res + " " + std::to_string(e.id) + " " + json(e.title).dump();
+}
+// after adding a schedule: what it collides with in the day index
+void _warn_conflicts(const Event& e) {
+    sync_index(local_today(), false);
+    auto list = conflicts_with(e, day_index, events);
+    if (list.empty()) return;
+    std::cout << "Warning: this schedule overlaps " << list.size() << " other occurrence(s):\n";
+    for (size_t i = 0; i < list.size() && i < 10; ++i) {
+        std::cout << "  " << _occurrence_line(*list[i].first.event, list[i].first.occ) << " overlaps " << _occurrence_line(*list[i].second.event, list[i].second.occ) << "\n";
+    }
+    if (list.size() > 10) std::cout << "  ...\n";
+}
 void add(int argc, char* argv[]) {
     if (argc == 0) return _help_add();
     std::string argv0(argv[0]);
@@ -570,82 +433,15 @@ void add(int argc, char* argv[]) {
         
         
         new_event["id"] = ++tot;
-        events.push_back(new_event);
-        save_events();
+        events.push_back(decode_event(new_event));
+        touch_event(tot);
+        if (_save() && argv0 == "schedule") _warn_conflicts(*find_event(tot));
     } else {
         std::cout << "Unknown command.\n";
         _help_add();
     }
 }
 
-Date add_days(Date d, int days) {
-    std::tm t = combine_date_time(d, Time{0, 0});
-    t.tm_mday += days;
-    std::mktime(&t);
-    return Date{t.tm_year + 1900, t.tm_mon + 1, t.tm_mday};
-}
-json merge_ban_intervals(json x) {
-    auto next_date = [&](const std::string& s) {
-        if (x["repetition"] == "Daily") {
-            return add_days(Date::parse(s), 1).dump();
-        }
-        if (x["repetition"] == "Weekly") {
-            auto d = Date::parse(s);
-            auto w = get_weekday(d);
-            auto days = x["enabled_days"];
-            auto it = ++std::lower_bound(days.begin(), days.end(), w);
-            if (it == days.end()) it = days.begin();
-            return add_days(d, (it->get<int>() - w + 7) % 7).dump();
-        }
-        if (x["repetition"] == "Monthly") {
-            auto d = Date::parse(s);
-            auto days = x["enabled_days"];
-            while (true) {
-                auto it = ++std::lower_bound(days.begin(), days.end(), d.day);
-                if (it == days.end() || it->get<int>() > get_month_day(d.year, d.month)) {
-                    ++d.month;
-                    d.day = 1;
-                    if (d.month > 12) {
-                        d.month = 1;
-                        ++d.year;
-                    }
-                } else {
-                    return Date{d.year, d.month, it->get<int>()}.dump();
-                }
-            }
-        }
-        if (x["repetition"] == "Yearly") {
-            auto d = Date::parse(s);
-            auto days = x["enabled_days"];
-            while (true) {
-                auto it = ++std::lower_bound(days.begin(), days.end(), DateWithoutYear{d.month, d.day}.dump());
-                if (it == days.end() || DateWithoutYear::parse(it->get<std::string>()).day > get_month_day(d.year, DateWithoutYear::parse(*it).month)) {
-                    ++d.year;
-                } else {
-                    return Date{d.year, DateWithoutYear::parse(it->get<std::string>()).month, DateWithoutYear::parse(it->get<std::string>()).day}.dump();
-                }
-            }
-        }
-        std::cout << "Unknown error occured\n";
-        exit(1);
-        return std::string("-1");
-    };
-    auto tmp = x["banned"];
-    std::sort(tmp.begin(), tmp.end(), [](json& a, json& b) {
-        if (a["l"] == "-1") return true;
-        return a["l"] < b["l"];
-    });
-    json res = json::array();
-    for (auto& e : tmp) {
-        if (!res.empty() && res.back()["r"] == "-1") break;
-        if (res.empty() || (e["l"] != "-1" && e["l"].get<std::string>() > next_date(res.back()["r"]))) {
-            res.push_back(e);
-        } else {
-            if (e["r"] == "-1" || e["r"] > res.back()["r"]) res.back()["r"] = e["r"];
-        }
-    }
-    return res;
-}
 void remove(int argc, char* argv[]) {
     if (argc == 0) return _help_remove();
     std::string argv0 = argv[0];
@@ -656,22 +452,21 @@ void remove(int argc, char* argv[]) {
         std::cout << "Invalid event id.\n";
         return;
     }
-    auto it = std::lower_bound(events.begin(), events.end(), id, [](json& a, int b) {
-        return a["id"] < b;
-    });
-    if (it == events.end() || it->at("id") != id) {
+    auto it = find_event(id);
+    if (it == events.end()) {
         std::cout << "Event not found.\n";
         return;
     }
+    touch_event(id);
     if (argc == 1) {
         events.erase(it);
-        save_events();
+        _save();
         return;
     }
     auto& e = *it;
-    if (e["repetition"] == "Once") {
+    if (e.repetition() == Repetition::Once) {
         events.erase(it);
-        save_events();
+        _save();
         return;
     }
     std::string s1, s2;
@@ -683,8 +478,6 @@ void remove(int argc, char* argv[]) {
             std::cout << "Invalid date(yyyy-mm-dd).\n";
             return;
         }
-        if (s1 != "-1") s1 = date1.dump();
-        s2 = s1;
         date2 = date1;
     }
     if (argc >= 3) {
@@ -696,186 +489,127 @@ void remove(int argc, char* argv[]) {
             std::cout << "Invalid date(yyyy-mm-dd).\n";
             return;
         }
-        if (s1 != "-1") s1 = date1.dump();
-        if (s2 != "-1") s2 = date2.dump();
     }
-    if (s1 != "-1" && s2 != "-1" && s1 > s2) {
+    // packed dates order like the "yyyy-mm-dd" strings, with NO_DATE ("-1") first
+    int k1 = date1.pack(), k2 = date2.pack();
+    if (k1 != NO_DATE && k2 != NO_DATE && k1 > k2) {
         std::cout << "Left date should be earlier than right date.\n";
         return;
     }
-    if (e["repetition"] == "Custom") {
-        std::sort(e["subevents"].begin(), e["subevents"].end(), [](json& a, json& b) {
-            return a["date"] < b["date"];
-        });
-        if (s1 == "-1") s1 = e["subevents"][0]["date"];
-        if (s2 == "-1") s2 = e["subevents"].back()["date"];
-        auto it1 = std::lower_bound(e["subevents"].begin(), e["subevents"].end(), s1, [](json& a, const std::string& b) {
-            return a["date"] < b;
+    if (auto rule = std::get_if<CustomRule>(&e.rule)) {
+        auto& subs = rule->subevents;
+        if (k1 == NO_DATE) k1 = subs[0].date;
+        if (k2 == NO_DATE) k2 = subs.back().date;
+        auto it1 = std::lower_bound(subs.begin(), subs.end(), k1, [](const Subevent& a, int b) {
+            return a.date < b;
         });
-        if (it1 == e["subevents"].end() || it1->at("date") != s1) {
+        if (it1 == subs.end() || it1->date != k1) {
             if (argc == 3) std::cout << "Left date not found.\n";
             else std::cout << "Date not found.\n";
             return;
         }
-        auto it2 = std::upper_bound(e["subevents"].begin(), e["subevents"].end(), s2, [](const std::string& a, json& b) {
-            return a < b["date"];
+        auto it2 = std::upper_bound(subs.begin(), subs.end(), k2, [](int a, const Subevent& b) {
+            return a < b.date;
         });
-        if (it2 == e["subevents"].begin() || prev(it2)->at("date") != s2) {
+        if (it2 == subs.begin() || prev(it2)->date != k2) {
             std::cout << "Right date not found.\n";
             return;
         }
-        for (auto subit = it1; subit != it2; ++subit) {
-            e["subevents"].erase(subit);
-        }
-        if (e["subevents"].empty()) {
+        subs.erase(it1, it2);
+        if (subs.empty()) {
             events.erase(it);
         }
-        save_events();
+        _save();
         return;
     }
-    if (s1 == "-1") s1 = e["start_date"], date1 = Date::parse(s1);
-    if (s2 == "-1") s2 = e["end_date"], date2 = Date::parse(s2);
-    if (s1 > s2) {
+    auto& span = *e.span();
+    if (k1 == NO_DATE) k1 = span.start_date, date1 = Date::unpack(k1);
+    if (k2 == NO_DATE) k2 = span.end_date, date2 = Date::unpack(k2);
+    if (k1 > k2) {
         std::cout << "Left date should be earlier than right date.\n";
         return;
     }
-    if (e["start_date"] != "-1" && s1 < e["start_date"]) {
+    if (span.start_date != NO_DATE && k1 < span.start_date) {
         if (argc == 2) std::cout << "Date not found\n";
         else std::cout << "Left date not found.\n";
         return;
     }
-    if (e["end_date"] != "-1" && s2 > e["end_date"]) {
+    if (span.end_date != NO_DATE && k2 > span.end_date) {
         if (argc == 2) std::cout << "Date not found\n";
         else std::cout << "Right date not found.\n";
         return;
     }
-    if (e["repetition"] == "Daily") {
-        e["banned"].push_back(json{{"l", s1}, {"r", s2}});
-        e["banned"] = merge_ban_intervals(e);
-        save_events();
-        return;
-    }
-    if (e["repetition"] == "Weekly") {
-        if (s1 != "-1" && !std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), get_weekday(date1))) {
+    if (e.repetition() != Repetition::Daily) {
+        if (k1 != NO_DATE && !day_enabled(e, k1)) {
             if (argc == 2) std::cout << "Date not found\n";
             else std::cout << "Left date not found.\n";
             return;
         }
-        if (s2 != "-1" && !std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), get_weekday(date2))) {
+        if (k2 != NO_DATE && !day_enabled(e, k2)) {
             if (argc == 2) std::cout << "Date not found\n";
             else std::cout << "Right date not found.\n";
             return;
         }
-        e["banned"].push_back(json{{"l", s1}, {"r", s2}});
-        e["banned"] = merge_ban_intervals(e);
-        if (e["banned"].size() == 1 && e["banned"][0] == json{{"l", e["start_date"]}, {"r", e["end_date"]}}) {
-            events.erase(it);
-        }
-        save_events();
-        return;
     }
-    if (e["repetition"] == "Monthly") {
-        if (s1 != "-1" && !std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), date1.day)) {
-            if (argc == 2) std::cout << "Date not found\n";
-            else std::cout << "Left date not found.\n";
-            return;
-        }
-        if (s2 != "-1" && !std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), date2.day)) {
-            if (argc == 2) std::cout << "Date not found\n";
-            else std::cout << "Right date not found.\n";
-            return;
-        }
-        e["banned"].push_back(json{{"l", s1}, {"r", s2}});
-        e["banned"] = merge_ban_intervals(e);
-        if (e["banned"].size() == 1 && e["banned"][0] == json{{"l", e["start_date"]}, {"r", e["end_date"]}}) {
-            events.erase(it);
-        }
-        save_events();
-        return;
-    }
-    if (e["repetition"] == "Yearly") {
-        if (s1 != "-1" && !std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), date1.dump().substr(5, 5))) {
-            if (argc == 2) std::cout << "Date not found\n";
-            else std::cout << "Left date not found.\n";
-            return;
-        }
-        if (s2 != "-1" && !std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), date2.dump().substr(5, 5))) {
-            if (argc == 2) std::cout << "Date not found\n";
-            else std::cout << "Right date not found.\n";
-            return;
-        }
-        e["banned"].push_back(json{{"l", s1}, {"r", s2}});
-        e["banned"] = merge_ban_intervals(e);
-        if (e["banned"].size() == 1 && e["banned"][0] == json{{"l", e["start_date"]}, {"r", e["end_date"]}}) {
-            events.erase(it);
-        }
-        save_events();
-        return;
+    // bans separated only by days the rule skips anyway become one
+    span.banned.insert(BanInterval{k1, k2}, [&](int r) {
+        return next_enabled_day(e, r + 1);
+    });
+    if (e.repetition() != Repetition::Daily && span.banned.size() == 1 && span.banned.begin()->first == span.start_date && span.banned.begin()->second == span.end_date) {
+        events.erase(it);
     }
-    std::cout << "Unknown error occurred.\n";
+    _save();
 }
-void _list_detail(json& e) {
-    std::cout << "ID: " << e["id"] << "\n";
-    std::cout << "Title: " << e["title"].get<std::string>() << "\n";
-    std::cout << "Description: " << e["description"].get<std::string>() << "\n";
-    std::cout << "Type: " << e["type"].get<std::string>() << "\n";
-    std::cout << "Priority: " << e["priority"].get<std::string>() << '\n';
-    std::cout << "Repetition: " << e["repetition"].get<std::string>() << '\n';
-    if (e["repetition"] == "Once") {
-        std::cout << "Date: " << e["date"].get<std::string>() << '\n';
-        if (e["type"] == "schedule") {
-            std::cout << "From " << e["start_time"].get<std::string>() << " to ";
-            std::cout << (Time::parse(e["start_time"]) + Duration::parse(e["duration"])).dump() << '\n';
-        } else {
-            std::cout << "Time: " << e["time"].get<std::string>() << '\n';
-        }
+void _list_slot(const Event& e, const Slot& s) {
+    if (e.is_schedule()) {
+        std::cout << "From " << Time::unpack(s.start).dump() << " to ";
+        std::cout << Time::unpack(s.end()).dump() << '\n';
+    } else {
+        std::cout << "Time: " << Time::unpack(s.start).dump() << '\n';
     }
-    if (e["repetition"] == "Custom") {
+}
+void _list_detail(const Event& e) {
+    std::cout << "ID: " << e.id << "\n";
+    std::cout << "Title: " << e.title << "\n";
+    std::cout << "Description: " << e.description << "\n";
+    std::cout << "Type: " << dump(e.type) << "\n";
+    std::cout << "Priority: " << dump(e.priority) << '\n';
+    std::cout << "Repetition: " << dump(e.repetition()) << '\n';
+    if (auto rule = std::get_if<OnceRule>(&e.rule)) {
+        std::cout << "Date: " << Date::unpack(rule->date).dump() << '\n';
+        _list_slot(e, e.slot);
+    }
+    if (auto rule = std::get_if<CustomRule>(&e.rule)) {
         std::cout << "Subevents:\n";
-        if (e["same_time_each_day"]) {
-            for (auto& sube : e["subevents"]) {
-                std::cout << "  Date: " << sube["date"] << "\n";
-                if (e["type"] == "schedule") {
-                    std::cout << "From " << e["start_time"].get<std::string>() << " to ";
-                    std::cout << (Time::parse(e["start_time"]) + Duration::parse(e["duration"])).dump() << '\n';
-                } else {
-                    std::cout << "Time: " << e["time"].get<std::string>() << '\n';
-                }
+        if (rule->same_time_each_day) {
+            for (auto& sube : rule->subevents) {
+                std::cout << "  Date: \"" << Date::unpack(sube.date).dump() << "\"\n";
+                _list_slot(e, e.slot);
             }
         } else {
-            for (auto& sube : e["subevents"]) {
-                std::cout << "  Date: " << sube["date"].get<std::string>() << "\n";
-                if (e["type"] == "schedule") {
-                    std::cout << "From " << sube["start_time"].get<std::string>() << " to ";
-                    std::cout << (Time::parse(sube["start_time"]) + Duration::parse(sube["duration"])).dump() << '\n';
-                } else {
-                    std::cout << "Time: " << sube["time"].get<std::string>() << '\n';
-                }
+            for (auto& sube : rule->subevents) {
+                std::cout << "  Date: " << Date::unpack(sube.date).dump() << "\n";
+                _list_slot(e, sube.slot);
             }
         }
     }
-    if (e["repetition"] != "Once" && e["repetition"] != "Custom") {
-        if (e["repetition"] != "Daily") {
+    if (auto span = e.span()) {
+        if (e.has_enabled_days()) {
             std::cout << "Enabled days: ";
-            for (auto& day : e["enabled_days"]) {
-                if (e["repetition"] != "Yearly") std::cout << day.get<int>() << " ";
-                else std::cout << day.get<std::string>() << " ";
+            for (int day : e.enabled_day_list()) {
+                if (e.repetition() != Repetition::Yearly) std::cout << day << " ";
+                else std::cout << DateWithoutYear::unpack(day).dump() << " ";
             }
             std::cout << '\n';
         }
-        std::cout << "Start date: " << e["start_date"].get<std::string>() << '\n';
-        std::cout << "End date: " << e["end_date"].get<std::string>() << '\n';
-        if (e["type"] == "schedule") {
-            std::cout << "From " << e["start_time"].get<std::string>() << " to ";
-            std::cout << (Time::parse(e["start_time"]) + Duration::parse(e["duration"])).dump() << '\n';
-        } else {
-            std::cout << "Time: " << e["time"].get<std::string>() << '\n';
-        }
+        std::cout << "Start date: " << Date::unpack(span->start_date).dump() << '\n';
+        std::cout << "End date: " << Date::unpack(span->end_date).dump() << '\n';
+        _list_slot(e, e.slot);
     }
     std::cout << "------------------\n";
 }
-void _list_brief(json& e) {
-    std::cout << e["id"] << " " << e["title"] << " " << e["type"] << " " << e["priority"] << " " << e["repetition"] << "\n";
+void _list_brief(const Event& e) {
+    std::cout << e.id << " " << json(e.title) << " " << json(dump(e.type)) << " " << json(dump(e.priority)) << " " << json(dump(e.repetition())) << "\n";
 }
 void list(int argc, char* argv[]) {
     if (argc == 0) return _help_list();
@@ -924,8 +658,8 @@ void list(int argc, char* argv[]) {
         }
     } else {
         for (auto& e : events) {
-            if (ids.count(e["id"])) {
-                ids.erase(e["id"]);
+            if (ids.count(e.id)) {
+                ids.erase(e.id);
                 if (detail) _list_detail(e);
                 else _list_brief(e);
             }
@@ -1049,7 +783,7 @@ void _edit_enabled(json& e){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), get_weekday(Date::parse(s)));
             });
     }else if(e["repetition"]=="Monthly"){
@@ -1076,7 +810,7 @@ void _edit_enabled(json& e){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), Date::parse(s).day);
             });
     }else if(e["repetition"]=="Yearly"){
@@ -1103,7 +837,7 @@ void _edit_enabled(json& e){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), s.substr(5, 5));
             });
     }else{
@@ -1125,7 +859,7 @@ void _edit_date(json& e,std::string &i){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return true;
             });
         }
@@ -1142,7 +876,7 @@ void _edit_date(json& e,std::string &i){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), get_weekday(Date::parse(s)));;
             });
         }
@@ -1159,7 +893,7 @@ void _edit_date(json& e,std::string &i){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), Date::parse(s).day);;
             });
         }
@@ -1176,7 +910,7 @@ void _edit_date(json& e,std::string &i){
                 if (s == "-1") return true;
                 if (Date::parse(s).day == -1) return false;
                 s = Date::parse(s).dump();
-                if (e["start_time"] != "-1" && s < e["start_date"]) return false;
+                if (Date::parse(s).pack() < Date::parse(e["start_date"]).pack()) return false;
                 return std::binary_search(e["enabled_days"].begin(), e["enabled_days"].end(), s.substr(5,5));;
             });
         }
@@ -1210,9 +944,25 @@ void _edit_type(json &e){
         e["time"]=read_time("Time: ").dump();
     }
 }
+void _edit_reminders(json& e){
+    std::cout<<"Original reminders are "<<e.value("reminders",json::array())<<",Please input new lead times."<<"\n";
+    std::string tmp = read_something("Reminders(hh:mm before the start, separated by space, empty for at the start only): ", "Invalid input, please enter again(hh:mm, separated by space): ", [](std::string& s) {
+        for (auto& x : split(s, ' ')) {
+            if (x != "" && Duration::parse(x).minute < 0) return false;
+        }
+        return true;
+    });
+    e["reminders"] = json::array();
+    for (auto& x : split(tmp, ' ')) {
+        if (x != "") e["reminders"].push_back(Duration::parse(x).dump());
+    }
+}
+
 void _edit_detail(json &e,std::vector<std::string>& details){
     for(auto i=details.begin();i!=details.end();++i){
-        if(e.count(*i)>0){
+        if(*i=="reminders"){
+            _edit_reminders(e);
+        }else if(e.count(*i)>0){
             if(*i=="title"){
                 std::cout<<"Original title is "<<e["title"]<<",Please input a new title."<<"\n";
                 e["title"] = read_anything("Title: ");
@@ -1271,25 +1021,22 @@ void edit(int argc,char* argv[]){
     if (argv0 == "-h" || argv0 == "--help") return _help_edit();
     read_events();
 
-    std::vector<json>::iterator it;
     int id = to_uint(argv0);
     if (id < 0) {
         std::cout << "Invalid event id.\n";
         return;
     }
-    it= std::lower_bound(events.begin(), events.end(), id, [](json& a, int b) {
-    return a["id"] < b;
-    });
-    if (it == events.end() || it->at("id") != id) {
+    auto it = find_event(id);
+    if (it == events.end()) {
         std::cout << "Event not found.\n";
         return;     
     }
+    json e = encode_event(*it);
     if(argc==1){
-        _edit_rule(*it);           
+        _edit_rule(e);           
         return;
     }
 
-    json e=*it;
     std::vector<std::string> details;
     bool type=false,detail=false,repetition=false;
     for(int i=1;i<argc;++i){
@@ -1332,36 +1079,395 @@ void edit(int argc,char* argv[]){
         std::cout<<"Invalid command.\n";
         return;
     }
-    *it=e;
-    save_events();
+    *it=decode_event(e);
+    touch_event(id);
+    _save();
 }
 
-int main(int argc, char* argv[]) {
-    system("chcp 65001");
+// one line per occurrence, written as the merge produces it
+void agenda(int argc, char* argv[]) {
+    if (argc == 0) return _help_agenda();
+    std::string argv0 = argv[0];
+    if (argv0 == "-h" || argv0 == "--help") return _help_agenda();
+    if (argc < 2) {
+        std::cout << "Please specify the range.\n";
+        return;
+    }
+    int from = Date::parse(argv[0]).pack(), to = Date::parse(argv[1]).pack();
+    if (from == NO_DATE || to == NO_DATE) {
+        std::cout << "Invalid date(yyyy-mm-dd).\n";
+        return;
+    }
+    if (from > to) {
+        std::cout << "Left date should be earlier than right date.\n";
+        return;
+    }
+    int limit = INT_MAX;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--limit" && i + 1 < argc) {
+            limit = to_uint(argv[++i]);
+            if (limit < 0) {
+                std::cout << "Invalid limit.\n";
+                return;
+            }
+        } else {
+            std::cout << "Invalid argument: " << arg << "\n";
+            return;
+        }
+    }
+    read_events();
+    Agenda merged(events, from, to);
+    Agenda::Item item;
+    for (int n = 0; n < limit && merged.next(item); ++n) {
+        std::cout << _occurrence_line(*item.event, item.occ) << " " << json(dump(item.event->type)) << "\n";
+    }
+}
+void conflicts(int argc, char* argv[]) {
+    if (argc > 0) {
+        std::string argv0 = argv[0];
+        if (argv0 == "-h" || argv0 == "--help") return _help_conflicts();
+    }
+    int from = local_today(), to = NO_DATE;
+    if (argc >= 1) from = Date::parse(argv[0]).pack();
+    if (argc >= 2) to = Date::parse(argv[1]).pack();
+    if (from == NO_DATE || (argc >= 2 && to == NO_DATE)) {
+        std::cout << "Invalid date(yyyy-mm-dd).\n";
+        return;
+    }
+    if (argc < 2) to = from + INDEX_FUTURE_DAYS;
+    if (from > to) {
+        std::cout << "Left date should be earlier than right date.\n";
+        return;
+    }
+    read_events();
+    int count = 0;
+    find_conflicts(events, from, to, [&](const ScheduleTime& a, const ScheduleTime& b) {
+        std::cout << _occurrence_line(*a.event, a.occ) << " overlaps " << _occurrence_line(*b.event, b.occ) << "\n";
+        ++count;
+    });
+    if (count == 0) std::cout << "No conflicts.\n";
+}
+std::string _minute_dump(long long minute) {
+    return Date::unpack(int(minute / 1440)).dump() + " " + Time::unpack(int(minute % 1440)).dump();
+}
+void free_slots(int argc, char* argv[]) {
+    if (argc == 0) return _help_free();
+    std::string argv0 = argv[0];
+    if (argv0 == "-h" || argv0 == "--help") return _help_free();
+    int length = Duration::parse(argv0).minute;
+    if (length <= 0) {
+        std::cout << "Invalid duration(hh:mm).\n";
+        return;
+    }
+    std::vector<std::string> dates;
+    int window_l = 0, window_r = 1440, limit = INT_MAX;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--within" && i + 1 < argc) {
+            auto x = split(std::string(argv[++i]), '-');
+            Time l = x.size() == 2 ? Time::parse(x[0]) : Time{-1, -1};
+            Time r = x.size() == 2 ? Time::parse(x[1]) : Time{-1, -1};
+            if (l.pack() < 0 || r.pack() <= l.pack()) {
+                std::cout << "Invalid time range(hh:mm-hh:mm).\n";
+                return;
+            }
+            window_l = l.pack(), window_r = r.pack();
+        } else if (arg == "--limit" && i + 1 < argc) {
+            limit = to_uint(argv[++i]);
+            if (limit < 0) {
+                std::cout << "Invalid limit.\n";
+                return;
+            }
+        } else if (dates.size() < 2 && arg.substr(0, 2) != "--") {
+            dates.push_back(arg);
+        } else {
+            std::cout << "Invalid argument: " << arg << "\n";
+            return;
+        }
+    }
+    time_t now = time(0);
+    auto [date, time] = split_date_time(*localtime(&now));
+    int first = dates.size() >= 1 ? Date::parse(dates[0]).pack() : date.pack();
+    int last = dates.size() >= 2 ? Date::parse(dates[1]).pack() : first + INDEX_FUTURE_DAYS;
+    if (first == NO_DATE || last == NO_DATE) {
+        std::cout << "Invalid date(yyyy-mm-dd).\n";
+        return;
+    }
+    // from now on today, from midnight on a given day
+    long long begin = first * 1440ll + (dates.size() >= 1 ? 0 : time.pack());
+    if (first > last) {
+        std::cout << "Left date should be earlier than right date.\n";
+        return;
+    }
+    read_events();
+    int count = 0;
+    find_free(events, begin, (last + 1) * 1440ll, length, window_l, window_r, [&](long long l, long long r) {
+        std::cout << _minute_dump(l) << " " << _minute_dump(r) << "\n";
+        return ++count < limit;
+    });
+}
+void changes(int argc, char* argv[]) {
+    if (argc == 0) return _help_changes();
+    std::string argv0 = argv[0];
+    if (argv0 == "-h" || argv0 == "--help") return _help_changes();
+    int since = to_uint(argv0);
+    if (argv0.empty() || since < 0) {
+        std::cout << "Invalid version.\n";
+        return;
+    }
+    read_events();
+    std::cout << changes_since(since).dump() << "\n";
+}
+// what is wrong with an event given in data.json form, "" if nothing
+std::string _check_event(const json& e) {
+    auto text = [](const json& j, const char* key) {
+        auto it = j.find(key);
+        return it != j.end() && it->is_string() ? it->get<std::string>() : std::string();
+    };
+    auto one_of = [](const std::string& s, std::initializer_list<const char*> options) {
+        return std::find(options.begin(), options.end(), s) != options.end();
+    };
+    std::string type = text(e, "type"), repetition = text(e, "repetition");
+    if (!one_of(type, {"schedule", "point", "deadline"})) return "type should be schedule, point or deadline";
+    if (!one_of(text(e, "priority"), {"Low", "Medium", "High"})) return "priority should be Low, Medium or High";
+    if (!one_of(repetition, {"Once", "Daily", "Weekly", "Monthly", "Yearly", "Custom"})) return "unknown repetition";
+    auto check_slot = [&](const json& j) -> std::string {
+        if (type != "schedule") return Time::parse(text(j, "time")).pack() < 0 ? "invalid time(hh:mm)" : "";
+        if (Time::parse(text(j, "start_time")).pack() < 0) return "invalid start_time(hh:mm)";
+        if (Duration::parse(text(j, "duration")).minute < 0) return "invalid duration(hh:mm)";
+        return "";
+    };
+    bool same_time = repetition != "Custom" || e.value("same_time_each_day", true);
+    if (same_time) {
+        std::string error = check_slot(e);
+        if (!error.empty()) return error;
+    }
+    if (repetition == "Once" && Date::parse(text(e, "date")).pack() == NO_DATE) return "invalid date(yyyy-mm-dd)";
+    // -1 is no bound, as the CLI writes it
+    auto bound = [](const std::string& s, int& day) {
+        day = Date::parse(s).pack();
+        return s == "-1" || day != NO_DATE;
+    };
+    if (repetition != "Once" && repetition != "Custom") {
+        int start, end;
+        if (!bound(text(e, "start_date"), start)) return "invalid start_date(yyyy-mm-dd, -1 for no start)";
+        if (!bound(text(e, "end_date"), end)) return "invalid end_date(yyyy-mm-dd, -1 for no end)";
+        if (start != NO_DATE && end != NO_DATE && end < start) return "end_date is earlier than start_date";
+        auto banned = e.find("banned");
+        if (banned != e.end()) {
+            if (!banned->is_array()) return "banned should be an array";
+            for (auto& ban : *banned) {
+                int l, r;
+                if (!ban.is_object() || !bound(text(ban, "l"), l) || !bound(text(ban, "r"), r)) return "invalid banned interval({\"l\": yyyy-mm-dd, \"r\": yyyy-mm-dd})";
+                if (l != NO_DATE && r != NO_DATE && r < l) return "banned interval ends before it starts";
+            }
+        }
+    }
+    if (repetition == "Weekly" || repetition == "Monthly" || repetition == "Yearly") {
+        auto days = e.find("enabled_days");
+        if (days == e.end() || !days->is_array()) return "enabled_days should be an array";
+        for (auto& d : *days) {
+            if (repetition == "Weekly" && !(d.is_number_integer() && d.get<int>() >= 0 && d.get<int>() <= 6)) return "invalid enabled day(0-6, 0 stands for Sunday)";
+            if (repetition == "Monthly" && !(d.is_number_integer() && d.get<int>() >= 1 && d.get<int>() <= 31)) return "invalid enabled day(1-31)";
+            if (repetition == "Yearly" && !(d.is_string() && DateWithoutYear::parse(d.get<std::string>()).month != -1)) return "invalid enabled day(mm-dd)";
+        }
+    }
+    if (repetition == "Custom") {
+        auto subs = e.find("subevents");
+        if (subs == e.end() || !subs->is_array() || subs->empty()) return "subevents should be a non-empty array";
+        for (auto& sub : *subs) {
+            if (!sub.is_object() || Date::parse(sub.value("date", "")).pack() == NO_DATE) return "invalid subevent date(yyyy-mm-dd)";
+            std::string error = same_time ? "" : check_slot(sub);
+            if (!error.empty()) return error;
+        }
+    }
+    return "";
+}
+// applies one operation of a batch; the id it concerns, or throws the reason
+// it was refused. removed holds the ids removed so far, still in events.
+int _batch_apply(const json& op, std::set<int>& removed) {
+    if (!op.is_object()) throw std::runtime_error("not a json object");
+    std::string name = op.value("op", "");
+    if (name == "add") {
+        auto e = op.find("event");
+        if (e == op.end() || !e->is_object()) throw std::runtime_error("add needs an event object");
+        std::string error = _check_event(*e);
+        if (!error.empty()) throw std::runtime_error(error);
+        json new_event = *e;
+        new_event["id"] = ++tot;
+        events.push_back(decode_event(new_event));  // ids only grow, so events stays sorted
+        touch_event(tot);
+        return tot;
+    }
+    if (name != "remove" && name != "edit") throw std::runtime_error("op should be add, remove or edit");
+    auto id_it = op.find("id");
+    if (id_it == op.end() || !id_it->is_number_integer()) throw std::runtime_error("id should be an integer");
+    int id = id_it->get<int>();
+    auto it = find_event(id);
+    if (it == events.end() || removed.count(id)) throw std::runtime_error("event not found");
+    if (name == "remove") {
+        removed.insert(id);
+    } else {
+        auto set = op.find("set");
+        if (set == op.end() || !set->is_object()) throw std::runtime_error("edit needs a set object");
+        json e = encode_event(*it);
+        for (auto& [key, value] : set->items()) {
+            if (key == "id") throw std::runtime_error("id cannot be edited");
+            e[key] = value;
+        }
+        std::string error = _check_event(e);
+        if (!error.empty()) throw std::runtime_error(error);
+        *it = decode_event(e);
+    }
+    touch_event(id);
+    return id;
+}
+// one load and one save for any number of operations; a refused line is
+// reported and skipped, the others still apply
+void batch(int argc, char* argv[]) {
+    std::string argv0 = argc ? argv[0] : "-";
+    if (argv0 == "-h" || argv0 == "--help") return _help_batch();
+    std::ifstream file;
+    if (argv0 != "-") {
+        file.open(argv0, std::ios::binary);
+        if (!file.is_open()) {
+            std::cout << "Cannot open " << argv0 << ".\n";
+            return;
+        }
+    }
+    std::istream& in = argv0 == "-" ? std::cin : file;
+    read_events();
+    std::set<int> removed;
+    std::string line;
+    std::vector<json> results;
+    int line_no = 0, applied = 0, failed = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        json result{{"line", line_no}};
+        try {
+            json op = json::parse(line);
+            result["id"] = _batch_apply(op, removed);
+            result["ok"] = true;
+            ++applied;
+        } catch (const std::exception& ex) {
+            result["ok"] = false;
+            result["error"] = ex.what();
+            ++failed;
+        }
+        results.push_back(result);
+    }
+    if (!removed.empty()) {
+        events.erase(std::remove_if(events.begin(), events.end(), [&](const Event& e) {
+            return removed.count(e.id);
+        }), events.end());
+    }
+    // nothing is applied if the save failed
+    if (applied && !save_events()) {
+        for (auto& result : results) {
+            if (!result["ok"].get<bool>()) continue;
+            result["ok"] = false;
+            result["error"] = "cannot write the data files";
+            result.erase("id");
+        }
+        failed += applied;
+        applied = 0;
+        save_failed = true;
+    }
+    for (auto& result : results) std::cout << result.dump() << "\n";
+    std::cout << json{{"applied", applied}, {"failed", failed}, {"version", calendar_version}}.dump() << "\n";
+}
+
+// argv as main gets it
+void run_command(int argc, char* argv[]) {
     if (argc == 1) {
         help(argc - 1, argv + 1);
-        return 0;
+        return;
     }
     std::string s = argv[1];
     if (s == "-h" || s == "--help") {
         help(argc - 2, argv + 2);
-        return 0;
+        return;
     }
     if (s == "-a" || s == "--add") {
         add(argc - 2, argv + 2);
-        return 0;
+        return;
     }
     if (s == "-r" || s == "--remove") {
         remove(argc - 2, argv + 2);
-        return 0;
+        return;
     }
     if (s == "-l" || s == "--list") {
         list(argc - 2, argv + 2);
-        return 0;
+        return;
     }
     if (s == "-e" || s == "--edit") {
         edit(argc - 2, argv + 2);
-        return 0;
+        return;
+    }
+    if (s == "--agenda") {
+        agenda(argc - 2, argv + 2);
+        return;
+    }
+    if (s == "--conflicts") {
+        conflicts(argc - 2, argv + 2);
+        return;
+    }
+    if (s == "--free") {
+        free_slots(argc - 2, argv + 2);
+        return;
+    }
+    if (s == "--changes-since") {
+        changes(argc - 2, argv + 2);
+        return;
+    }
+    if (s == "--batch") {
+        batch(argc - 2, argv + 2);
+        return;
+    }
+    if (s == "--compact") {
+        if (argc > 2 && (std::string(argv[2]) == "-h" || std::string(argv[2]) == "--help")) return _help_compact();
+        read_events();
+        if (!compact()) std::cout << "Cannot write " << DATA_FILE << ", the journal is kept.\n";
+        return;
     }
     //加入-e分支
-}
\ No newline at end of file
+}
+// read-only commands, which a running daemon can answer from memory;
+// interactive and saving ones always run in-process
+bool _forwardable(const std::string& s) {
+    return s == "-l" || s == "--list" || s == "--agenda" || s == "--conflicts" || s == "--free" || s == "--changes-since";
+}
+// exit status of planalyze --daemon
+int serve_daemon() {
+    FileWatch watch({DATA_FILE, BINARY_FILE, JOURNAL_FILE});
+    resident_watch = &watch;
+    bool served = run_daemon([](const std::vector<std::string>& args) {
+        std::vector<char*> argv{(char*)"planalyze"};
+        for (auto& x : args) argv.push_back((char*)x.c_str());
+        std::ostringstream out;
+        auto saved = std::cout.rdbuf(out.rdbuf());
+        try {
+            run_command((int)argv.size(), argv.data());
+        } catch (const std::exception& ex) {
+            std::cout << "Error: " << ex.what() << "\n";
+        }
+        std::cout.rdbuf(saved);
+        return out.str();
+    });
+    return served ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    // what chcp 65001 did, without starting a shell
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCP(CP_UTF8);
+    std::string s = argc > 1 ? argv[1] : "";
+    if (s == "--daemon") {
+        return serve_daemon();
+    }
+    if (_forwardable(s) && daemon_forward(std::vector<std::string>(argv + 1, argv + argc), std::cout)) return 0;
+    run_command(argc, argv);
+    return save_failed ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Upcoming reminder instants of every event in one min-heap, so the reminder
+// server can sleep until the earliest one instead of waking every minute.
+// Instants are absolute minutes since 1970-01-01 00:00 local time.
+//
+// Replacing the instants of one event only touches that event: its old heap
+// entries stay where they are and are dropped when they surface, recognised by
+// a stale generation number. The heap is rebuilt from the live entries once
+// the stale ones outnumber them.
+class ReminderQueue {
+public:
+    // the pending instants of id become minutes; false if they already were
+    bool schedule(int id, std::vector<int> minutes) {
+        std::sort(minutes.begin(), minutes.end());
+        minutes.erase(std::unique(minutes.begin(), minutes.end()), minutes.end());
+        auto it = pending.find(id);
+        if (it != pending.end() && it->second.minutes == minutes) return false;
+        if (minutes.empty()) {
+            if (it != pending.end()) drop(it);
+            return it != pending.end();
+        }
+        if (it == pending.end()) it = pending.emplace(id, Pending()).first;
+        else live -= it->second.minutes.size();
+        it->second.minutes = std::move(minutes);
+        it->second.generation = ++generations;
+        for (int m : it->second.minutes) heap.push(Fire{m, id, it->second.generation});
+        live += it->second.minutes.size();
+        compact();
+        return true;
+    }
+    // replaces the instants of every event with fires (id -> minutes); events
+    // missing from it lose theirs. Returns how many events changed.
+    int assign(std::map<int, std::vector<int>> fires) {
+        int changed = 0;
+        for (auto it = pending.begin(); it != pending.end();) {
+            auto cur = it++;
+            if (!fires.count(cur->first)) {
+                drop(cur);
+                ++changed;
+            }
+        }
+        for (auto& [id, minutes] : fires) changed += schedule(id, std::move(minutes));
+        return changed;
+    }
+    // earliest pending instant, INT_MAX if there is none
+    int next() {
+        prune();
+        return heap.empty() ? INT_MAX : heap.top().minute;
+    }
+    // removes and returns the (minute, id) pairs due at or before minute, in
+    // time order
+    std::vector<std::pair<int, int>> pop_due(int minute) {
+        std::vector<std::pair<int, int>> res;
+        while (next() <= minute) {
+            Fire f = heap.top();
+            heap.pop();
+            auto it = pending.find(f.id);
+            auto& v = it->second.minutes;
+            v.erase(v.begin());  // popped in order, so always the first
+            --live;
+            if (v.empty()) pending.erase(it);
+            res.emplace_back(f.minute, f.id);
+        }
+        return res;
+    }
+    size_t size() const { return live; }
+
+private:
+    struct Fire {
+        int minute, id;
+        unsigned generation;
+        bool operator>(const Fire& other) const {
+            if (minute != other.minute) return minute > other.minute;
+            return id > other.id;
+        }
+    };
+    struct Pending {
+        std::vector<int> minutes;  // sorted
+        unsigned generation = 0;
+    };
+    std::priority_queue<Fire, std::vector<Fire>, std::greater<Fire>> heap;
+    std::map<int, Pending> pending;
+    size_t live = 0;
+    unsigned generations = 0;
+
+    bool stale(const Fire& f) const {
+        auto it = pending.find(f.id);
+        return it == pending.end() || it->second.generation != f.generation;
+    }
+    void prune() {
+        while (!heap.empty() && stale(heap.top())) heap.pop();
+    }
+    void drop(std::map<int, Pending>::iterator it) {
+        live -= it->second.minutes.size();
+        pending.erase(it);
+        compact();
+    }
+    void compact() {
+        if (heap.size() <= 2 * live + 64) return;
+        std::vector<Fire> fresh;
+        fresh.reserve(live);
+        for (auto& [id, p] : pending) {
+            for (int m : p.minutes) fresh.push_back(Fire{m, id, p.generation});
+        }
+        heap = decltype(heap)(std::greater<Fire>(), std::move(fresh));
+    }
+};
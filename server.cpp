@@ -1,305 +1,419 @@
+#define WIN32_LEAN_AND_MEAN  // keeps winsock.h out of the way of notify.hpp
 #include <windows.h>
 #include "json.hpp"
-#include <windows.h>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <map>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include "agenda.hpp"
+#include "calendar.hpp"
+#include "event.hpp"
+#include "file_watch.hpp"
+#include "http_server.hpp"
+#include "notify.hpp"
+#include "reminder_queue.hpp"
+#include "storage.hpp"
 
 using json = nlohmann::json;
 
-bool is_leap_year(int year) {
-    if (year % 400 == 0) return 1;
-    if (year % 100 == 0) return 0;
-    if (year % 4 == 0) return 1;
-    return 0;
-}
-int get_month_day(int year, int month) {
-    if (month == 2) return is_leap_year(year) + 28;
-    if (month < 8) return 30 + month % 2;
-    return 31 - month % 2;
+// the queue holds reminders from now to the end of tomorrow; it is refilled
+// from the occurrence index when the day changes, and only the changed events'
+// entries are replaced when data is updated
+const int REMINDER_HORIZON_DAYS = 1;
+// waking later than planned by more than this means the machine was suspended
+// or the clock jumped forward; the reminders of the gap are then listed in one
+// notification, at most CATCH_UP_LIST of them from the last CATCH_UP_MAX_DAYS
+const long long CATCH_UP_SLACK_MS = 90 * 1000;
+const int CATCH_UP_MAX_DAYS = 7;
+const size_t CATCH_UP_LIST = 10;
+// local HTTP API (see occurrences_response), 0 turns it off
+const int HTTP_PORT = 8765;
+const int OCCURRENCES_MAX_DAYS = 400;
+
+int cur_day;
+int fired_through;  // last minute whose reminders went out
+long long planned_wake;  // local_millis() the main loop meant to wake at
+int http_port = HTTP_PORT;
+// held by the main thread while it changes events or day_index, and by the
+// HTTP thread while it reads them
+std::mutex calendar_mutex;
+ReminderQueue reminders;
+Notifier notifier;
+std::vector<std::pair<int, size_t>> event_hashes;  // (id, content_hash) in id order
+// the data files a save of planalyze writes; the index is kept in memory
+FileWatch data_watch({DATA_FILE, BINARY_FILE, JOURNAL_FILE});
+HttpResponse api_response(const HttpRequest& req);
+HttpServer http(api_response);
+
+// milliseconds since 1970-01-01 00:00 local time
+long long local_millis() {
+    auto now = std::chrono::system_clock::now();
+    time_t t = std::chrono::system_clock::to_time_t(now);
+    std::tm ltm = *localtime(&t);
+    auto [date, clock] = split_date_time(ltm);
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+    return ((long long)date.pack() * 86400 + clock.pack() * 60 + ltm.tm_sec) * 1000 + ms;
 }
 
-std::string to_string(int x, int n = -1) {
-    std::string res;
-    for (int i = 0; n == -1 ? x : (i < n); ++i) res += char(x % 10 + '0'), x /= 10;
-    std::reverse(res.begin(), res.end());
-    return res;
+// lead times of e, a lone 0 when it has none
+const std::vector<int>& lead_times(const Event& e) {
+    static const std::vector<int> at_start{0};
+    return e.leads.empty() ? at_start : e.leads;
 }
-int to_uint(std::string s) {
-    int res = 0;
-    for (char c : s) {
-        if (!isdigit(c)) return -1;
-        res = res * 10 + c - '0';
-    }
-    return res;
+// days after the queued range whose occurrences can still remind inside it
+int lead_days(const Event& e) {
+    return (lead_times(e).back() + 1439) / 1440;
 }
-std::vector<std::string> split(std::string s, char c) {
-    std::vector<std::string> res{""};
-    for (auto& x : s) {
-        if (x == c) res.push_back("");
-        else res.back() += x;
+// instants of one occurrence starting at minute that fall after fired_through
+// and inside the queued range; a lead may reach back over midnight
+void add_fires(const Event& e, int start, std::vector<int>& out) {
+    int horizon_end = (cur_day + REMINDER_HORIZON_DAYS + 1) * 1440;
+    for (int lead : lead_times(e)) {
+        int minute = start - lead;
+        if (minute > fired_through && minute < horizon_end) out.push_back(minute);
     }
-    return res;
 }
 
-struct Date {
-    int year, month, day;
-    static Date parse(std::string s) {
-        auto x = split(s, '-');
-        if (x.size() != 3) return Date{-1, -1, -1};
-        int year = to_uint(x[0]);
-        int month = to_uint(x[1]);
-        int day = to_uint(x[2]);
-        if (year < 1900 || month < 1 || day < 1) return Date{-1, -1, -1};
-        if (month > 12 || day > get_month_day(year, month)) return Date{-1, -1, -1};
-        return Date{year, month, day};
-    }
-    std::string dump() {
-        if (year < 0) return "-1";
-        return to_string(year, 4) + "-" + to_string(month, 2) + "-" + to_string(day, 2);
-    }
-    bool operator<(const Date& other) const {
-        if (year != other.year) return year < other.year;
-        if (month != other.month) return month < other.month;
-        return day < other.day;
-    }
-    bool operator==(const Date& other) const {
-        return year == other.year && month == other.month && day == other.day;
+// reminder instants after fired_through straight from the occurrence index;
+// only events whose instants differ are touched in the queue
+void queue_reminders() {
+    int max_lead_days = 0;
+    for (auto& e : events) max_lead_days = std::max(max_lead_days, lead_days(e));
+    std::map<int, std::vector<int>> fires;
+    for (int day = cur_day; day <= cur_day + REMINDER_HORIZON_DAYS + max_lead_days; ++day) {
+        for (auto& entry : day_index.on(day)) {
+            auto it = find_event(entry.id);
+            if (it == events.end() || entry.slot.start < 0) continue;
+            add_fires(*it, day * 1440 + entry.slot.start, fires[entry.id]);
+        }
     }
-};
-struct DateWithoutYear {
-    int month, day;
-    static DateWithoutYear parse(std::string s) {
-        auto x = split(s, '-');
-        if (x.size() != 2) return DateWithoutYear{-1, -1};
-        int month = to_uint(x[0]);
-        int day = to_uint(x[1]);
-        if (month < 1 || day < 1) return DateWithoutYear{-1, -1};
-        if (month > 12 || day > get_month_day(2000, month)) return DateWithoutYear{-1, -1};
-        return DateWithoutYear{month, day};
+    for (auto it = fires.begin(); it != fires.end();) {
+        if (it->second.empty()) it = fires.erase(it);
+        else ++it;
     }
-    std::string dump() {
-        if (month < 0) return "-1";
-        return to_string(month, 2) + "-" + to_string(day, 2);
+    reminders.assign(std::move(fires));
+}
+// ids added, removed or changed since the last call, by merging the sorted
+// (id, hash) lists of the two loads
+std::vector<int> changed_events() {
+    std::vector<std::pair<int, size_t>> hashes;
+    hashes.reserve(events.size());
+    for (auto& e : events) hashes.emplace_back(e.id, content_hash(e));
+    std::vector<int> res;
+    size_t i = 0, j = 0;
+    while (i < event_hashes.size() || j < hashes.size()) {
+        if (j == hashes.size() || (i < event_hashes.size() && event_hashes[i].first < hashes[j].first)) {
+            res.push_back(event_hashes[i++].first);
+        } else if (i == event_hashes.size() || hashes[j].first < event_hashes[i].first) {
+            res.push_back(hashes[j++].first);
+        } else {
+            if (event_hashes[i].second != hashes[j].second) res.push_back(hashes[j].first);
+            ++i, ++j;
+        }
     }
-    bool operator<(const DateWithoutYear& other) const {
-        if (month != other.month) return month < other.month;
-        return day < other.day;
+    event_hashes = std::move(hashes);
+    return res;
+}
+// replaces the index entries and reminders of the changed events only;
+// returns for each the days it occurred or occurs on inside the index window,
+// as {"id", "from", "to"} with to exclusive, without from/to if there are none
+json update_events(const std::vector<int>& ids) {
+    json res = json::array();
+    for (int id : ids) {
+        auto it = find_event(id);
+        const Event* e = it == events.end() ? nullptr : &*it;
+        std::vector<int> days = day_index.days_of(id);
+        day_index.update(id, e);
+        auto& now = day_index.days_of(id);
+        days.insert(days.end(), now.begin(), now.end());
+        json change{{"id", id}};
+        if (!days.empty()) {
+            auto [l, r] = std::minmax_element(days.begin(), days.end());
+            change["from"] = Date::unpack(*l).dump();
+            change["to"] = Date::unpack(*r + 1).dump();
+        }
+        res.push_back(std::move(change));
+        std::vector<int> fires;
+        if (e) {
+            for (auto& occ : occurrences(*e, cur_day, cur_day + REMINDER_HORIZON_DAYS + lead_days(*e))) {
+                if (occ.slot.start >= 0) add_fires(*e, occ.date * 1440 + occ.slot.start, fires);
+            }
+        }
+        reminders.schedule(id, std::move(fires));
     }
-    bool operator==(const DateWithoutYear& other) const {
-        return month == other.month && day == other.day;
+    return res;
+}
+
+void check_update(bool changed, bool new_day) {
+    std::lock_guard<std::mutex> lock(calendar_mutex);
+    if (changed) {
+        read_events();
+        json changes = update_events(changed_events());
+        // a save that changed nothing (or only the binary copy) is not news
+        if (!changes.empty()) http.broadcast("change", json{{"version", calendar_version}, {"changes", changes}}.dump());
     }
-};
-struct Time {
-    int hour, minute;
-    static Time parse(std::string s) {
-        auto x = split(s, ':');
-        if (x.size() != 2) return Time{-1, -1};
-        int hour = to_uint(x[0]);
-        int minute = to_uint(x[1]);
-        if (hour < 0 || hour > 23 || minute < 0 || minute > 59) return Time{-1, -1};
-        return Time{hour, minute};
+    if (new_day) {
+        day_index.roll(events, cur_day);
+        queue_reminders();
     }
-    std::string dump() {
-        if (minute < 0) return "-1";
-        return to_string(hour, 2) + ":" + to_string(minute, 2);
+}
+
+// the title, with how long until the start when the instant is a lead time
+std::string reminder_text(const Event& e, int minute) {
+    auto& leads = lead_times(e);
+    for (auto& occ : occurrences(e, minute / 1440, minute / 1440 + lead_days(e))) {
+        int lead = occ.date * 1440 + occ.slot.start - minute;
+        if (occ.slot.start < 0 || lead < 0 || !std::binary_search(leads.begin(), leads.end(), lead)) continue;
+        if (lead == 0) break;
+        return e.title + " (in " + std::to_string(lead / 60) + ":" + to_string(lead % 60, 2) + ")";
     }
-    bool operator<(const Time& other) const {
-        if (other.hour != hour) return hour < other.hour;
-        return minute < other.minute;
+    return e.title;
+}
+
+std::wstring convert(std::string s) {
+    static std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+    return converter.from_bytes(s);
+}
+
+// the popup the server always showed. The dialogs are modal, so one thread of
+// the sink's own shows them and deliver() only hands it the text: an
+// unanswered dialog holds up neither the other sinks nor the scheduler, and
+// reminders that come meanwhile are shown together in the next dialog.
+class MessageBoxSink : public NotificationSink {
+public:
+    MessageBoxSink() : ui(std::make_shared<Ui>()) {
+        std::thread([ui = ui] { ui->run(); }).detach();
     }
-};
-struct Duration {
-    int minute;
-    static Duration parse(std::string s) {
-        auto x = split(s, ':');
-        if (x.size() == 0) {
-            return Duration{0};
-        }
-        if (x.size() == 1) {
-            return Duration{to_uint(x[0])};
+    // the thread may sit in a dialog nobody answers, so it is not joined; it
+    // holds on to ui and ends after the dialog
+    ~MessageBoxSink() override {
+        {
+            std::lock_guard<std::mutex> lock(ui->mutex);
+            ui->stopping = true;
         }
-        if (x.size() == 2) {
-            int hour = to_uint(x[0]);
-            int minute = to_uint(x[1]);
-            if (hour < 0 || minute < 0 || minute > 59) return Duration{-1};
-            return Duration{hour * 60 + minute};
-        }
-        return Duration{-1};
+        ui->ready.notify_one();
     }
-    std::string dump() {
-        return to_string(minute / 60) + ":" + to_string(minute % 60, 2);
+    void deliver(const Notification& n) override {
+        {
+            std::lock_guard<std::mutex> lock(ui->mutex);
+            ui->pending += convert(n.text());
+        }
+        ui->ready.notify_one();
     }
-};
 
-std::tm combine_date_time(Date d, Time t) {
-    std::tm res;
-    res.tm_year = d.year - 1900;
-    res.tm_mon = d.month - 1;
-    res.tm_mday = d.day;
-    res.tm_hour = t.hour;
-    res.tm_min = t.minute;
-    res.tm_sec = 0;
-    res.tm_isdst = -1;
-    return res;
-}
-std::pair<Date, Time> split_date_time(std::tm t) {
-    return {Date{t.tm_year + 1900, t.tm_mon + 1, t.tm_mday}, Time{t.tm_hour, t.tm_min}};
-}
+private:
+    struct Ui {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::wstring pending;  // text of the reminders not shown yet
+        bool stopping = false;
 
-int get_weekday(Date d) {
-    std::tm t = combine_date_time(d, Time{0, 0});
-    std::mktime(&t);
-    return t.tm_wday;
-}
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                ready.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (stopping) return;
+                std::wstring text;
+                text.swap(pending);
+                lock.unlock();
+                MessageBoxW(NULL, text.c_str(), L"Reminder", MB_OK | MB_TOPMOST | MB_SYSTEMMODAL);
+                lock.lock();
+            }
+        }
+    };
+    std::shared_ptr<Ui> ui;
+};
 
-Time operator+(Time a, const Duration& b) {
-    a.minute += b.minute;
-    a.hour += a.minute / 60;
-    a.minute %= 60;
-    a.hour %= 24;
-    return a;
+std::string minute_text(int minute) {
+    return Date::unpack(minute / 1440).dump() + " " + Time::unpack(minute % 1440).dump();
 }
 
-std::vector<json> events;
-
-std::string read_from_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) return "";
-    std::string res;
-    while (true) {
-        char c = file.get();
-        if (file.eof()) break;
-        res += c;
+// (minute, id) of every reminder in [from, to), by a range query over the
+// occurrences rather than a replay of the gap minute by minute
+std::vector<std::pair<int, int>> reminders_between(int from, int to) {
+    int max_lead_days = 0;
+    for (auto& e : events) max_lead_days = std::max(max_lead_days, lead_days(e));
+    std::vector<std::pair<int, int>> res;
+    Agenda agenda(events, from / 1440, (to - 1) / 1440 + max_lead_days);
+    Agenda::Item item;
+    while (agenda.next(item)) {
+        if (item.occ.slot.start < 0) continue;
+        int start = item.occ.date * 1440 + item.occ.slot.start;
+        for (int lead : lead_times(*item.event)) {
+            if (start - lead >= from && start - lead < to) res.emplace_back(start - lead, item.event->id);
+        }
     }
-    file.close();
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
     return res;
 }
-bool write_to_file(const std::string& filename, const std::string& content) {
-    std::ofstream file(filename);
-    if (!file.is_open()) return true;
-    file << content;
-    file.close();
-    return false;
-}
-
-int tot;
-
-void read_events() {
-    std::string tmp = read_from_file("data.json");
-    if (tmp == "") tmp = "{}";
-    json data = json::parse(tmp);
-    if (data.size() == 0) {
-        data["total"] = 0;
-        data["events"] = json::array();
+void catch_up(int from, int to) {
+    from = std::max(from, to - CATCH_UP_MAX_DAYS * 1440);
+    auto missed = reminders_between(from, to);
+    if (missed.empty()) return;
+    Notification n{minute_text(to), {"Missed " + std::to_string(missed.size()) + " reminder(s) since " + minute_text(from) + ":"}};
+    for (size_t i = 0; i < missed.size() && i < CATCH_UP_LIST; ++i) {
+        auto it = find_event(missed[i].second);
+        if (it != events.end()) n.lines.push_back(minute_text(missed[i].first) + " " + reminder_text(*it, missed[i].first));
     }
-    tot = data["total"];
-    events = data["events"];
-    std::sort(events.begin(), events.end(), [](const json& a, const json& b) {
-        return a["id"] < b["id"];
-    });
+    if (missed.size() > CATCH_UP_LIST) n.lines.push_back("...");
+    notifier.post(std::move(n));
 }
 
-std::string cur_date;
-std::string cur_time;
-bool new_day;
-
-std::map<std::string, std::vector<std::string>> mp;
-
-void handle_event(json& event) {
-    std::string op = "time";
-    if (event["type"] == "schedule") op = "start_time";
-    if (event["repetition"] == "Once") {
-        if (event["date"].get<std::string>() == cur_date) {
-            mp[event[op].get<std::string>()].push_back(event["title"].get<std::string>());
-        }
-    } else if (event["repetition"] == "Custom") {
-        if (event["same_time_each_day"]) {
-            for (auto e : event["subevents"]) {
-                if (e["date"].get<std::string>() == cur_date) {
-                    mp[event[op].get<std::string>()].push_back(e["title"].get<std::string>());
-                }
-            }
-        } else {
-            for (auto e : event["subevents"]) {
-                if (e["date"].get<std::string>() == cur_date) {
-                    mp[e[op].get<std::string>()].push_back(e["title"].get<std::string>());
-                }
-            }
-        }
+// posts everything due up to now, one notification per instant
+void handle(bool changed) {
+    long long now = local_millis();
+    int minute = now / 60000;
+    bool jumped = now > planned_wake + CATCH_UP_SLACK_MS || minute < fired_through;
+    // day changes are seen whenever the date differs, however long the gap
+    bool new_day = minute / 1440 != cur_day;
+    cur_day = minute / 1440;
+    if (jumped) {
+        check_update(changed, false);
+        if (minute > fired_through + 1) catch_up(fired_through + 1, minute);
+        // a clock set back reminds of the repeated minutes again
+        fired_through = minute - 1;
+        check_update(false, true);
     } else {
-        if (event["repetition"] == "Weekly") {
-            auto tmp = event["enabled_days"];
-            if (!std::binary_search(tmp.begin(), tmp.end(), get_weekday(Date::parse(cur_date)))) return;
-        } else if (event["repetition"] == "Monthly") {
-            auto tmp = event["enabled_days"];
-            if (!std::binary_search(tmp.begin(), tmp.end(), Date::parse(cur_date).day)) return;
-        } else if (event["repetition"] == "Yearly") {
-            auto tmp = event["enabled_days"];
-            if (!std::binary_search(tmp.begin(), tmp.end(), cur_date.substr(5, 5))) return;
-        }
-        if (cur_date < event["start_date"].get<std::string>() ||
-            cur_date > event["end_date"].get<std::string>()) return;
-        auto tmp = event["banned"];
-        for (auto ban : tmp) {
-            if (cur_date <= ban["r"].get<std::string>() &&
-                cur_date >= ban["l"].get<std::string>()) return;
+        check_update(changed, new_day);
+    }
+    auto due = reminders.pop_due(minute);
+    fired_through = std::max(fired_through, minute);
+    for (size_t i = 0; i < due.size();) {
+        int at = due[i].first;
+        Notification n{minute_text(at), {}};
+        for (; i < due.size() && due[i].first == at; ++i) {
+            auto it = find_event(due[i].second);
+            if (it != events.end()) n.lines.push_back(reminder_text(*it, at));
         }
-        mp[event[op].get<std::string>()].push_back(event["title"].get<std::string>());
+        if (!n.lines.empty()) notifier.post(std::move(n));
     }
 }
 
-void check_update() {
-    bool need_update = new_day;
-    if (read_from_file("update.txt") == "1") {
-        read_events();
-        write_to_file("update.txt", "0");
-        need_update = 1;
-    }
-    new_day = 0;
-    if (!need_update) return;
-    mp.clear();
-    for (auto& e : events) {
-        handle_event(e);
+// GET /occurrences?from=yyyy-mm-dd&to=yyyy-mm-dd, to exclusive as in
+// FullCalendar's fetchInfo: the occurrences in time order, entries as in
+// data.index.bin plus their date, and each event they belong to once
+HttpResponse occurrences_response(const HttpRequest& req) {
+    auto date_of = [&](const char* key) {
+        auto it = req.query.find(key);
+        return it == req.query.end() ? NO_DATE : Date::parse(it->second.substr(0, 10)).pack();
+    };
+    int from = date_of("from"), to = date_of("to");
+    if (from == NO_DATE || to == NO_DATE || from >= to) return HttpResponse{400, "{\"error\":\"from and to should be dates(yyyy-mm-dd), from before to\"}"};
+    if (to - from > OCCURRENCES_MAX_DAYS) return HttpResponse{400, "{\"error\":\"range too large\"}"};
+    json res;
+    res["from"] = Date::unpack(from).dump();
+    res["to"] = Date::unpack(to).dump();
+    res["events"] = json::array();
+    res["occurrences"] = json::array();
+    std::lock_guard<std::mutex> lock(calendar_mutex);
+    std::vector<const Event*> seen;
+    Agenda agenda(events, from, to - 1);
+    Agenda::Item item;
+    while (agenda.next(item)) {
+        json occ{{"id", item.event->id}, {"date", Date::unpack(item.occ.date).dump()}};
+        if (item.occ.slot.start >= 0) {
+            occ["time"] = Time::unpack(item.occ.slot.start).dump();
+            occ["duration"] = item.occ.slot.duration;
+        }
+        res["occurrences"].push_back(std::move(occ));
+        seen.push_back(item.event);
     }
+    std::sort(seen.begin(), seen.end());
+    seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+    for (auto e : seen) res["events"].push_back(encode_event(*e));
+    return HttpResponse{200, res.dump()};
+}
+// GET /stream: Server-Sent Events, one "change" event per save that touched
+// events, {"version": V, "changes": [...]} with the ranges of update_events()
+HttpResponse stream_response(const HttpRequest&) {
+    std::lock_guard<std::mutex> lock(calendar_mutex);
+    HttpResponse res{200, "retry: 3000\nevent: version\ndata: " + json{{"version", calendar_version}}.dump() + "\n\n"};
+    res.stream = true;
+    return res;
+}
+// GET /changes?since=V: see changes_since() in storage.hpp
+HttpResponse changes_response(const HttpRequest& req) {
+    auto it = req.query.find("since");
+    int since = it == req.query.end() || it->second.empty() ? -1 : to_uint(it->second);
+    if (since < 0) return HttpResponse{400, "{\"error\":\"since should be a calendar version\"}"};
+    std::lock_guard<std::mutex> lock(calendar_mutex);
+    return HttpResponse{200, changes_since(since).dump()};
+}
+HttpResponse api_response(const HttpRequest& req) {
+    if (req.path == "/occurrences") return occurrences_response(req);
+    if (req.path == "/changes") return changes_response(req);
+    if (req.path == "/stream") return stream_response(req);
+    return HttpResponse{404, "{\"error\":\"not found\"}"};
 }
 
-const wchar_t* convert(std::string s) {
-    static std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-    std::wstring wideStr = converter.from_bytes(s);
-    return wideStr.c_str();
+void _help() {
+    std::cout << "Usage: " << std::endl;
+    std::cout << "  server.exe                            show reminders in message boxes" << std::endl;
+    std::cout << "  server.exe [--stdout]                 print reminders" << std::endl;
+    std::cout << "  server.exe [--log <FILE>]             append reminders to a file" << std::endl;
+    std::cout << "  server.exe [--socket <PATH>]          send reminders as json lines to a Unix domain socket" << std::endl;
+    std::cout << "  server.exe [--post <URL>]             POST reminders as json to http://host[:port][/path]" << std::endl;
+    std::cout << "  server.exe [--http <PORT>]            serve /occurrences, /changes and /stream on 127.0.0.1:PORT, 8765 by default, 0 for none" << std::endl;
+    std::cout << "  server.exe [--origin <ORIGIN>]        let pages of ORIGIN (e.g. http://localhost:8080) read them too" << std::endl;
+    std::cout << "  options can be combined; --box adds the message boxes back" << std::endl;
 }
 
-void handle() {
-    check_update();
-    std::string res = "";
-    if (mp.find(cur_time) == mp.end()) return;
-    for (auto& e : mp[cur_time]) {
-        res += e + "\n";
+// false after printing the problem
+bool parse_args(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--box") notifier.add(std::make_unique<MessageBoxSink>());
+        else if (arg == "--stdout") notifier.add(std::make_unique<StdoutSink>());
+        else if (arg == "--log" && has_value) notifier.add(std::make_unique<LogFileSink>(argv[++i]));
+        else if (arg == "--socket" && has_value) notifier.add(std::make_unique<UnixSocketSink>(argv[++i]));
+        else if (arg == "--http" && has_value) {
+            http_port = to_uint(argv[++i]);
+            if (http_port < 0 || http_port > 65535) {
+                std::cout << "Invalid port: " << argv[i] << "\n";
+                return false;
+            }
+        }
+        else if (arg == "--origin" && has_value) http.allow_origin(argv[++i]);
+        else if (arg == "--post" && has_value) {
+            auto sink = std::make_unique<HttpPostSink>();
+            if (!sink->parse(argv[++i])) {
+                std::cout << "Invalid url: " << argv[i] << "\n";
+                return false;
+            }
+            notifier.add(std::move(sink));
+        } else {
+            if (arg != "-h" && arg != "--help") std::cout << "Invalid argument: " << arg << "\n";
+            _help();
+            return false;
+        }
     }
-    MessageBoxW(NULL, convert(res), convert("Reminder"), MB_OK | MB_TOPMOST | MB_SYSTEMMODAL);
+    if (notifier.empty()) notifier.add(std::make_unique<MessageBoxSink>());
+    return true;
 }
 
-int main() {
-    time_t now = time(0);
-    std::tm ltm = *localtime(&now);
-    cur_date = Date{ltm.tm_year + 1900, ltm.tm_mon + 1, ltm.tm_mday}.dump();
-    cur_time = Time{ltm.tm_hour, ltm.tm_min}.dump();
+int main(int argc, char* argv[]) {
+    if (!parse_args(argc, argv)) return 1;
     read_events();
-    new_day = 1;
-    check_update();
+    changed_events();
+    // reminders of the minute in progress at startup are not replayed
+    planned_wake = local_millis();
+    fired_through = planned_wake / 60000;
+    cur_day = fired_through / 1440;
+    sync_index(cur_day, true);
+    queue_reminders();
+    if (http_port && !http.start(http_port)) std::cerr << "Cannot listen on port " << http_port << "\n";
     while (true) {
-        now = time(0);
-        ltm = *localtime(&now);
-        int count = 60 - ltm.tm_sec;
-        Sleep(count * 1000);
-        now = time(0);
-        ltm = *localtime(&now);
-        cur_date = Date{ltm.tm_year + 1900, ltm.tm_mon + 1, ltm.tm_mday}.dump();
-        cur_time = Time{ltm.tm_hour, ltm.tm_min}.dump();
-        if (cur_time == "00:00") new_day = 1;
-        handle();
+        // sleep until the next reminder or midnight, waking early when data changes
+        long long now = local_millis();
+        long long midnight = (now / 86400000 + 1) * 86400000;
+        planned_wake = std::min((long long)reminders.next() * 60000, midnight);
+        auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(planned_wake - now);
+        handle(data_watch.wait_until(deadline));
     }
-}
\ No newline at end of file
+}
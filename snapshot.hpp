@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "event.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary snapshot of the calendar (data.bin), written next to data.json so the
+// programs can start without running json::parse over the whole file.
+//
+// layout, all integers native-endian:
+//   SnapshotHeader
+//   SnapshotRecord[count]    fixed width, sorted by id
+//   int32_t pool[pool_size]  variable-length parts, referenced by offset/count
+//                            from the records: bans as (l, r) pairs, enabled
+//                            days, subevents as (date, completed, start,
+//                            duration), reminder lead times
+//   int32_t changes[2 * change_count]  (id, calendar version) of the last
+//                            change of every id, see storage.hpp
+//   char heap[heap_size]     strings, referenced by offset/length
+// json stays the interchange format; the snapshot is only trusted when it is
+// at least as new as data.json.
+
+const uint32_t SNAPSHOT_MAGIC = 0x425a4c50;  // "PLZB"
+const uint32_t SNAPSHOT_VERSION = 4;  // 2: dates are days since 1970-01-01, 3: leads, 4: changes
+
+struct SnapshotHeader {
+    uint32_t magic, version;
+    int32_t total, calendar_version;
+    uint32_t count, pool_size, change_count, heap_size;
+};
+struct SnapshotString {
+    uint32_t offset, length;
+};
+struct SnapshotRecord {
+    int32_t id;
+    uint8_t type, priority, repetition, flag;  // flag: Once completed / Custom same_time_each_day
+    int32_t start, duration;                   // Slot
+    int32_t date_l, date_r;                    // Once date, or the span's start/end
+    uint32_t pool_offset, bans, days, subevents, leads;
+    SnapshotString title, description, category, completed;
+};
+
+// read-only mapping of a whole file, empty if it cannot be opened
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER n;
+        if (!GetFileSizeEx(file, &n) || n.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) return;
+        void* p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (p == NULL) return;
+        data = (const char*)p;
+        size = (size_t)n.QuadPart;
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = (const char*)p;
+                size = st.st_size;
+            }
+        }
+        close(fd);
+#endif
+    }
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping != NULL) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap((void*)data, size);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+bool write_snapshot(const std::string& filename, const std::vector<Event>& events, int total, int calendar_version, const std::map<int, int>& changes) {
+    std::vector<SnapshotRecord> records;
+    std::vector<int32_t> pool;
+    std::string heap;
+    auto put_string = [&](const std::string& s) {
+        SnapshotString res{(uint32_t)heap.size(), (uint32_t)s.size()};
+        heap += s;
+        return res;
+    };
+    records.reserve(events.size());
+    for (auto& e : events) {
+        SnapshotRecord r{};
+        r.id = e.id;
+        r.type = (uint8_t)e.type;
+        r.priority = (uint8_t)e.priority;
+        r.repetition = (uint8_t)e.repetition();
+        r.start = e.slot.start;
+        r.duration = e.slot.duration;
+        r.date_l = r.date_r = NO_DATE;
+        r.pool_offset = (uint32_t)pool.size();
+        r.title = put_string(e.title);
+        r.description = put_string(e.description);
+        r.category = put_string(e.category);
+        if (auto x = std::get_if<OnceRule>(&e.rule)) {
+            r.date_l = x->date;
+            r.flag = x->completed;
+        } else if (auto x = std::get_if<CustomRule>(&e.rule)) {
+            r.flag = x->same_time_each_day;
+            r.subevents = (uint32_t)x->subevents.size();
+            for (auto& s : x->subevents) {
+                pool.insert(pool.end(), {s.date, s.completed, s.slot.start, s.slot.duration});
+            }
+        } else {
+            auto span = e.span();
+            r.date_l = span->start_date;
+            r.date_r = span->end_date;
+            r.completed = put_string(span->completed.dump());
+            r.bans = (uint32_t)span->banned.size();
+            for (auto& [l, r] : span->banned) pool.insert(pool.end(), {l, r});
+            auto days = e.enabled_day_list();
+            r.days = (uint32_t)days.size();
+            pool.insert(pool.end(), days.begin(), days.end());
+        }
+        r.leads = (uint32_t)e.leads.size();
+        pool.insert(pool.end(), e.leads.begin(), e.leads.end());
+        records.push_back(r);
+    }
+    std::vector<int32_t> change_pairs;
+    change_pairs.reserve(2 * changes.size());
+    for (auto& [id, v] : changes) change_pairs.insert(change_pairs.end(), {id, v});
+    SnapshotHeader h{SNAPSHOT_MAGIC, SNAPSHOT_VERSION, total, calendar_version, (uint32_t)records.size(), (uint32_t)pool.size(), (uint32_t)changes.size(), (uint32_t)heap.size()};
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file.write((const char*)&h, sizeof(h));
+    file.write((const char*)records.data(), records.size() * sizeof(SnapshotRecord));
+    file.write((const char*)pool.data(), pool.size() * sizeof(int32_t));
+    file.write((const char*)change_pairs.data(), change_pairs.size() * sizeof(int32_t));
+    file.write(heap.data(), heap.size());
+    file.close();
+    return !file.fail();
+}
+
+// false if the file is missing, foreign or truncated; events is untouched then
+bool load_snapshot(const std::string& filename, std::vector<Event>& events, int& total, int& calendar_version, std::map<int, int>& changes) {
+    MappedFile file(filename);
+    if (file.size < sizeof(SnapshotHeader)) return false;
+    SnapshotHeader h;
+    std::memcpy(&h, file.data, sizeof(h));
+    if (h.magic != SNAPSHOT_MAGIC || h.version != SNAPSHOT_VERSION) return false;
+    uint64_t need = sizeof(h) + (uint64_t)h.count * sizeof(SnapshotRecord) + ((uint64_t)h.pool_size + 2ull * h.change_count) * sizeof(int32_t) + h.heap_size;
+    if (need != file.size) return false;
+    const char* records = file.data + sizeof(h);
+    const char* pool_base = records + (size_t)h.count * sizeof(SnapshotRecord);
+    const char* heap = pool_base + ((size_t)h.pool_size + 2 * (size_t)h.change_count) * sizeof(int32_t);
+    auto pool = [&](uint64_t i) {
+        int32_t x;
+        std::memcpy(&x, pool_base + (size_t)i * sizeof(int32_t), sizeof(x));
+        return x;
+    };
+    std::vector<Event> res;
+    res.reserve(h.count);
+    for (uint32_t i = 0; i < h.count; ++i) {
+        SnapshotRecord r;
+        std::memcpy(&r, records + (size_t)i * sizeof(r), sizeof(r));
+        uint64_t pool_need = (uint64_t)r.pool_offset + 2ull * r.bans + r.days + 4ull * r.subevents + r.leads;
+        if (pool_need > h.pool_size) return false;
+        if (r.type > (uint8_t)EventType::Deadline || r.priority > (uint8_t)Priority::High || r.repetition > (uint8_t)Repetition::Custom) return false;
+        for (auto s : {r.title, r.description, r.category, r.completed}) {
+            if ((uint64_t)s.offset + s.length > h.heap_size) return false;
+        }
+        auto get_string = [&](SnapshotString s) { return std::string(heap + s.offset, s.length); };
+        Event e;
+        e.id = r.id;
+        e.type = EventType(r.type);
+        e.priority = Priority(r.priority);
+        e.title = get_string(r.title);
+        e.description = get_string(r.description);
+        e.category = get_string(r.category);
+        e.slot = Slot{r.start, r.duration};
+        uint32_t p = r.pool_offset;
+        Span span;
+        span.start_date = r.date_l;
+        span.end_date = r.date_r;
+        for (uint32_t k = 0; k < r.bans; ++k, p += 2) span.banned.insert(BanInterval{pool(p), pool(p + 1)});
+        std::vector<int> days;
+        for (uint32_t k = 0; k < r.days; ++k) days.push_back(pool(p++));
+        switch (Repetition(r.repetition)) {
+        case Repetition::Once: e.rule = OnceRule{r.date_l, r.flag != 0}; break;
+        case Repetition::Daily: e.rule = DailyRule{span}; break;
+        case Repetition::Weekly:
+        case Repetition::Monthly:
+        case Repetition::Yearly: e.rule = _make_day_rule(Repetition(r.repetition), span, days); break;
+        case Repetition::Custom: {
+            CustomRule rule;
+            rule.same_time_each_day = r.flag != 0;
+            for (uint32_t k = 0; k < r.subevents; ++k, p += 4) {
+                rule.subevents.push_back(Subevent{pool(p), pool(p + 1) != 0, Slot{pool(p + 2), pool(p + 3)}});
+            }
+            e.rule = rule;
+            break;
+        }
+        }
+        for (uint32_t k = 0; k < r.leads; ++k) e.leads.push_back(pool(p++));
+        if (auto x = e.span(); x && r.completed.length > 2) {  // anything but "[]"
+            x->completed = json::parse(get_string(r.completed), nullptr, false);
+            if (!x->completed.is_array()) x->completed = json::array();
+        }
+        res.push_back(std::move(e));
+    }
+    changes.clear();
+    for (uint64_t k = 0; k < h.change_count; ++k) {
+        changes[pool(h.pool_size + 2 * k)] = pool(h.pool_size + 2 * k + 1);
+    }
+    events = std::move(res);
+    total = h.total;
+    calendar_version = h.calendar_version;
+    return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// The little of BSD sockets both programs need, with the winsock differences
+// papered over. On Windows link with ws2_32.
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+const socket_t NO_SOCKET = INVALID_SOCKET;
+inline void close_socket(socket_t s) { closesocket(s); }
+inline int poll_sockets(pollfd* fds, size_t n, int timeout_ms) { return WSAPoll(fds, (ULONG)n, timeout_ms); }
+inline void set_nonblocking(socket_t s, bool on = true) {
+    u_long x = on;
+    ioctlsocket(s, FIONBIO, &x);
+}
+inline bool _connect_pending() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+using socket_t = int;
+const socket_t NO_SOCKET = -1;
+inline void close_socket(socket_t s) { close(s); }
+inline int poll_sockets(pollfd* fds, size_t n, int timeout_ms) { return poll(fds, n, timeout_ms); }
+inline void set_nonblocking(socket_t s, bool on = true) {
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+}
+inline bool _connect_pending() { return errno == EINPROGRESS; }
+#endif
+
+// a peer that went away must not kill the process with SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+inline void _socket_startup() {
+#ifdef _WIN32
+    static bool done = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    (void)done;
+#endif
+}
+
+// blocking send and recv on s fail after timeout_ms instead of waiting for a
+// peer that stopped reading or answering
+inline void set_timeouts(socket_t s, int timeout_ms) {
+#ifdef _WIN32
+    DWORD timeout = timeout_ms;
+#else
+    timeval timeout{timeout_ms / 1000, timeout_ms % 1000 * 1000};
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+// connect that gives up after timeout_ms; s is left blocking
+inline bool connect_within(socket_t s, const sockaddr* addr, socklen_t len, int timeout_ms) {
+    set_nonblocking(s);
+    bool ok = connect(s, addr, len) == 0;
+    if (!ok && _connect_pending()) {
+        pollfd fd{s, POLLOUT, 0};
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        ok = poll_sockets(&fd, 1, timeout_ms) == 1 && getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&error, &error_len) == 0 && error == 0;
+    }
+    set_nonblocking(s, false);
+    return ok;
+}
+
+// one stream connection, closed when it goes out of scope
+class Connection {
+public:
+    explicit Connection(socket_t s = NO_SOCKET) : s(s) {}
+    ~Connection() {
+        if (s != NO_SOCKET) close_socket(s);
+    }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    void send_all(const std::string& data) {
+        for (size_t done = 0; done < data.size();) {
+            auto n = send(s, data.data() + done, (int)(data.size() - done), SEND_FLAGS);
+            if (n <= 0) throw std::runtime_error("send failed");
+            done += n;
+        }
+    }
+    std::string receive_some() {
+        char buf[512];
+        auto n = recv(s, buf, sizeof(buf), 0);
+        return n > 0 ? std::string(buf, n) : std::string();
+    }
+
+    socket_t s;
+};
+
+// listening TCP socket on 127.0.0.1:port, NO_SOCKET if it cannot be had
+inline socket_t listen_local(int port) {
+    _socket_startup();
+    socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NO_SOCKET) return NO_SOCKET;
+    int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, SOMAXCONN) != 0) {
+        close_socket(s);
+        return NO_SOCKET;
+    }
+    set_nonblocking(s);
+    return s;
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "event.hpp"
+#include "event_sax.hpp"
+#include "file_watch.hpp"
+#include "occurrence_index.hpp"
+#include "snapshot.hpp"
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// data.json is the last snapshot of the calendar. Every mutation after it is
+// appended to data.journal as one compact json line:
+//   {"op":"put","total":N,"version":V,"event":{...}}   add or replace the event with that id
+//   {"op":"del","total":N,"version":V,"id":ID}         remove the event
+// read_events() replays the journal on top of the snapshot; compact() folds it
+// back into data.json once it grows past COMPACT_THRESHOLD records. Compaction
+// also writes data.bin (see snapshot.hpp), which is loaded instead of
+// data.json whenever it is not older than it.
+//
+// Every save_events() that changes something bumps calendar_version, and
+// changed_at remembers for each id, removed ones included, the version of its
+// last change. Both survive compaction ("version" and "changes" in data.json),
+// so changes_since() can answer any client with only what it has not seen.
+//
+// data.index.bin holds the day -> occurrences index of occurrence_index.hpp.
+// Saves leave it alone: it records the calendar version it was built at, and
+// sync_index() re-expands only the events changed after that. Compaction and
+// the reminder server write it back, and so does whoever has to rebuild it.
+const std::string DATA_FILE = "data.json";
+const std::string BINARY_FILE = "data.bin";
+const std::string JOURNAL_FILE = "data.journal";
+const std::string INDEX_FILE = "data.index.bin";
+const int COMPACT_THRESHOLD = 1000;
+
+// set by a resident process (planalyze --daemon): read_events() then keeps
+// what it holds as long as none of the watched data files changed
+FileWatch* resident_watch = nullptr;
+bool resident_loaded = false;
+
+std::vector<Event> events;
+int tot;
+int calendar_version;
+std::map<int, int> changed_at;  // id -> calendar_version of its last change
+int journal_records;
+std::vector<int> touched;  // ids changed since read_events()
+bool journal_torn;
+OccurrenceIndex day_index;
+
+// events is kept sorted by id
+std::vector<Event>::iterator find_event(int id) {
+    auto it = std::lower_bound(events.begin(), events.end(), id, [](const Event& a, int b) {
+        return a.id < b;
+    });
+    if (it != events.end() && it->id != id) return events.end();
+    return it;
+}
+
+std::string read_from_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) return "";
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+// next to filename and private to this process, so that concurrent writers
+// (the CLI and the reminder server) never share a temporary file
+std::string _temp_name(const std::string& filename) {
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = getpid();
+#endif
+    return filename + "." + std::to_string(pid) + ".tmp";
+}
+bool write_to_file(const std::string& filename, const std::string& content) {
+    std::ofstream file(filename);
+    if (!file.is_open()) return true;
+    file << content;
+    file.close();
+    return false;
+}
+
+// writes content with the fopen mode given ("wb" replaces, "ab" appends) and
+// waits until it is on disk, so that a save that returned survives a crash;
+// true on failure, like write_to_file()
+bool _write_synced(const std::string& filename, const std::string& content, const char* mode) {
+    FILE* file = std::fopen(filename.c_str(), mode);
+    if (!file) return true;
+    bool failed = std::fwrite(content.data(), 1, content.size(), file) != content.size() || std::fflush(file) != 0;
+#ifdef _WIN32
+    failed = failed || _commit(_fileno(file)) != 0;
+#else
+    failed = failed || fsync(fileno(file)) != 0;
+#endif
+    return std::fclose(file) != 0 || failed;
+}
+bool append_to_file_synced(const std::string& filename, const std::string& content) {
+    return _write_synced(filename, content, "ab");
+}
+// puts a file written by someone else on disk; true on failure
+bool _sync_file(const std::string& filename) {
+    return _write_synced(filename, "", "ab");
+}
+// puts the renames done in the current directory on disk; true on failure.
+// Windows writes renames through, there is nothing to do.
+bool _sync_directory() {
+#ifdef _WIN32
+    return false;
+#else
+    int fd = open(".", O_RDONLY);
+    if (fd < 0) return true;
+    bool failed = fsync(fd) != 0;
+    return close(fd) != 0 || failed;
+#endif
+}
+
+// true if it appended events, which may leave them out of id order
+bool replay_journal() {
+    journal_records = 0;
+    journal_torn = false;
+    std::ifstream file(JOURNAL_FILE);
+    if (!file.is_open()) return false;
+    std::map<int, json> latest;  // null for removed events
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        json rec = json::parse(line, nullptr, false);
+        if (rec.is_discarded()) {  // torn tail from an interrupted append
+            journal_torn = true;
+            continue;
+        }
+        ++journal_records;
+        tot = std::max(tot, rec.value("total", 0));
+        int version = rec.value("version", 0);
+        calendar_version = std::max(calendar_version, version);
+        int id = rec["op"] == "put" ? rec["event"]["id"].get<int>() : rec["id"].get<int>();
+        latest[id] = rec["op"] == "put" ? rec["event"] : json(nullptr);
+        changed_at[id] = version;
+    }
+    if (latest.empty()) return false;
+    events.erase(std::remove_if(events.begin(), events.end(), [&](const Event& e) {
+        return latest.count(e.id);
+    }), events.end());
+    bool appended = false;
+    for (auto& [id, e] : latest) {
+        if (!e.is_null()) events.push_back(decode_event(e)), appended = true;
+    }
+    return appended;
+}
+bool binary_snapshot_usable() {
+    std::error_code ec;
+    auto bin = std::filesystem::last_write_time(BINARY_FILE, ec);
+    if (ec) return false;
+    auto text = std::filesystem::last_write_time(DATA_FILE, ec);
+    return ec || text <= bin;
+}
+// changes through the journal are told apart by version; a data.json newer
+// than the index was replaced behind planalyze's back, and an index newer than
+// the calendar belongs to another one
+bool load_index() {
+    std::error_code ec;
+    auto index = std::filesystem::last_write_time(INDEX_FILE, ec);
+    if (ec) return false;
+    auto text = std::filesystem::last_write_time(DATA_FILE, ec);
+    if (!ec && text > index) return false;
+    return day_index.load(INDEX_FILE) && day_index.version <= calendar_version;
+}
+void save_index() {
+    std::string tmp = _temp_name(INDEX_FILE);
+    if (day_index.save(tmp)) std::filesystem::rename(tmp, INDEX_FILE);
+}
+// brings day_index up to date with events and today, from disk when possible:
+// only the events changed since the index was written are expanded again.
+// With save, writes it back if that changed anything. An index rebuilt from
+// scratch is written back anyway, so that the next reader does not pay for
+// the rebuild again, unless save_rebuild is false.
+void sync_index(int today, bool save, bool save_rebuild = true) {
+    bool changed = true, rebuilt = false;
+    if (load_index()) {
+        changed = day_index.roll(events, today);
+        for (auto& [id, v] : changed_at) {
+            if (v <= day_index.version) continue;
+            auto it = find_event(id);
+            day_index.update(id, it == events.end() ? nullptr : &*it);
+            changed = true;
+        }
+    } else {
+        day_index.rebuild(events, today);
+        rebuilt = true;
+    }
+    day_index.version = calendar_version;
+    if (changed && (save || (rebuilt && save_rebuild))) save_index();
+}
+// decode data.json in one SAX pass over the mapped file, no DOM and no copy
+// of the text; false if its events were not in id order
+bool load_json_snapshot() {
+    MappedFile file(DATA_FILE);
+    EventSaxLoader loader;
+    if (file.size && !json::sax_parse(file.data, file.data + file.size, &loader)) {
+        throw std::runtime_error(DATA_FILE + ": " + loader.error);
+    }
+    tot = loader.total;
+    calendar_version = loader.version;
+    changed_at = std::move(loader.changes);
+    events = std::move(loader.events);
+    return loader.sorted;
+}
+void read_events() {
+    touched.clear();
+    if (resident_watch && !resident_watch->changed() && resident_loaded) return;
+    bool in_order = true;  // data.bin is always written in id order
+    if (!binary_snapshot_usable() || !load_snapshot(BINARY_FILE, events, tot, calendar_version, changed_at)) {
+        in_order = load_json_snapshot();
+    }
+    auto by_id = [](const Event& a, const Event& b) {
+        return a.id < b.id;
+    };
+    if (replay_journal()) in_order = in_order && std::is_sorted(events.begin(), events.end(), by_id);
+    if (!in_order) std::sort(events.begin(), events.end(), by_id);
+    resident_loaded = true;
+}
+// rewrite the snapshot from memory and drop the journal; the snapshot is
+// replaced atomically first, so a crash in between only replays
+// already-applied (idempotent) records. false if data.json could not be put
+// on disk, in which case the journal is kept and still holds every change.
+bool compact() {
+    json data;
+    data["total"] = tot;
+    data["version"] = calendar_version;
+    data["changes"] = json::object();
+    for (auto& [id, v] : changed_at) data["changes"][std::to_string(id)] = v;
+    data["events"] = json::array();
+    for (auto& e : events) {
+        data["events"].push_back(encode_event(e));
+    }
+    // brought up to date while the old data.json still vouches for it; it is
+    // written below, after data.json
+    sync_index(local_today(), false, false);
+    std::error_code ec;
+    std::string tmp = _temp_name(DATA_FILE);
+    if (_write_synced(tmp, data.dump(4), "wb")) {
+        std::filesystem::remove(tmp, ec);  // a full disk leaves part of it
+        return false;
+    }
+    std::filesystem::rename(tmp, DATA_FILE, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    if (_sync_directory()) return false;
+    // written after data.json so that it is never the older of the two; if it
+    // cannot be written the old one is older and ignored
+    tmp = _temp_name(BINARY_FILE);
+    if (write_snapshot(tmp, events, tot, calendar_version, changed_at) && !_sync_file(tmp)) {
+        std::filesystem::rename(tmp, BINARY_FILE, ec);
+    }
+    std::filesystem::remove(tmp, ec);
+    save_index();
+    std::filesystem::remove(JOURNAL_FILE);
+    journal_records = 0;
+    journal_torn = false;
+    touched.clear();
+    return true;
+}
+// callers mark every event they add, change or remove before saving
+void touch_event(int id) {
+    touched.push_back(id);
+}
+// false if the changes could not be put on disk
+bool save_events() {
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    std::string records;
+    if (!touched.empty()) ++calendar_version;
+    for (int id : touched) {
+        auto it = find_event(id);
+        json rec;
+        rec["total"] = tot;
+        rec["version"] = calendar_version;
+        changed_at[id] = calendar_version;
+        if (it != events.end()) {
+            rec["op"] = "put";
+            rec["event"] = encode_event(*it);
+        } else {
+            rec["op"] = "del";
+            rec["id"] = id;
+        }
+        records += rec.dump() + "\n";
+        ++journal_records;
+    }
+    touched.clear();
+    // never append behind a torn line, the next record would be glued to it
+    if ((journal_torn || journal_records >= COMPACT_THRESHOLD) && compact()) return true;
+    return !journal_torn && !append_to_file_synced(JOURNAL_FILE, records);
+}
+// events changed after version since and ids removed after it, as
+// {"version": V, "full": bool, "events": [...], "deleted": [...]}. A client
+// that has seen nothing yet (since <= 0), or a version this calendar never
+// had, gets every event with "full" set and should replace what it holds.
+json changes_since(int since) {
+    json res;
+    bool full = since <= 0 || since > calendar_version;
+    res["version"] = calendar_version;
+    res["full"] = full;
+    res["events"] = json::array();
+    res["deleted"] = json::array();
+    for (auto& e : events) {
+        auto it = changed_at.find(e.id);
+        if (full || (it != changed_at.end() && it->second > since)) res["events"].push_back(encode_event(e));
+    }
+    if (full) return res;
+    for (auto& [id, v] : changed_at) {
+        if (v > since && find_event(id) == events.end()) res["deleted"].push_back(id);
+    }
+    return res;
+}